@@ -0,0 +1,297 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+// Results of the timed calls land here so the compiler keeps them
+static volatile long bench_sink;
+
+double benchNowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double lhs = *(const double *)a;
+  double rhs = *(const double *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+// Sorts values in place
+BenchStats_t benchStats(double *values, int count) {
+  BenchStats_t stats = {0};
+  if (count > 0) {
+    qsort(values, count, sizeof(double), compareDoubles);
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+      sum += values[i];
+    }
+    stats.min = values[0];
+    stats.p50 = values[count / 2];
+    stats.p90 = values[(int)(count * 0.9)];
+    stats.p99 = values[(int)(count * 0.99)];
+    stats.max = values[count - 1];
+    stats.mean = sum / count;
+  }
+  return stats;
+}
+
+// Fresh moving game over ten rows of seeded garbage, every row has a hole
+void prepareBoard(TetrisInfo_t *game, uint64_t seed) {
+  initTetrisInfo(game);
+  seedTetrisGame(game, seed);
+  setVirtualClock(game, 0);
+  Rng_t rng;
+  seedRng(&rng, seed);
+  for (int line = kRows / 2; line < kRows; line++) {
+    uint64_t garbage = nextRandom(&rng);
+    if (sizeof(Row_t) > sizeof(uint32_t)) {
+      garbage = garbage << 32 | nextRandom(&rng);
+    }
+    game->field.row[line] = (Row_t)(garbage & FULL_ROW) &
+                            (Row_t)~((Row_t)1 << randomBelow(&rng, kCols));
+  }
+  syncFieldMeta(&game->field);
+  generateNextFigure(game);
+  game->state = kMoving;
+}
+
+static void placeFigure(TetrisInfo_t *game, Tetromino_t type, int x, int y) {
+  setFigure(&game->current.fig, type);
+  game->current.coordinate.x = x;
+  game->current.coordinate.y = y;
+}
+
+static void prepareMoving(TetrisInfo_t *game, uint64_t seed, int index) {
+  prepareBoard(game, seed + (uint64_t)index);
+  placeFigure(game, kFigureT, 1 + index % 6, 2);
+}
+
+static void runCheckNewPosition(TetrisInfo_t *game) {
+  game->current.offset_x = -1;
+  bench_sink += checkNewPosition(game);
+  game->current.offset_x = 0;
+}
+
+static void runTryMoveFigure(TetrisInfo_t *game) {
+  bench_sink += tryMoveFigure(game, Left);
+}
+
+static void runTryRotateFigure(TetrisInfo_t *game) {
+  bench_sink += tryRotateFigure(game);
+}
+
+static void prepareDrop(TetrisInfo_t *game, uint64_t seed, int index) {
+  prepareBoard(game, seed + (uint64_t)index);
+  placeFigure(game, (Tetromino_t)(index % kTetrominoes), 3, 0);
+}
+
+static void runDropFigure(TetrisInfo_t *game) {
+  dropFigure(game);
+  bench_sink += game->current.coordinate.y;
+}
+
+// Vertical I in column 0 on four rows, the lowest lines of them are full
+static void prepareAttaching(TetrisInfo_t *game, uint64_t seed, int index,
+                             int lines) {
+  prepareBoard(game, seed + (uint64_t)index);
+  for (int line = kRows - kFigRows; line < kRows; line++) {
+    game->field.row[line] = line >= kRows - lines
+                                ? (Row_t)(FULL_ROW & ~(Row_t)1)
+                                : (Row_t)(game->field.row[line] & ~(Row_t)3);
+  }
+  syncFieldMeta(&game->field);
+  placeFigure(game, kFigureI, -1, kRows - kFigRows);
+  game->current.fig.rotation = 3;
+}
+
+static void prepareAttaching0(TetrisInfo_t *game, uint64_t seed, int index) {
+  prepareAttaching(game, seed, index, 0);
+}
+
+static void prepareAttaching1(TetrisInfo_t *game, uint64_t seed, int index) {
+  prepareAttaching(game, seed, index, 1);
+}
+
+static void prepareAttaching2(TetrisInfo_t *game, uint64_t seed, int index) {
+  prepareAttaching(game, seed, index, 2);
+}
+
+static void prepareAttaching3(TetrisInfo_t *game, uint64_t seed, int index) {
+  prepareAttaching(game, seed, index, 3);
+}
+
+static void prepareAttaching4(TetrisInfo_t *game, uint64_t seed, int index) {
+  prepareAttaching(game, seed, index, 4);
+}
+
+static void runHandleAttaching(TetrisInfo_t *game) {
+  bench_sink += handleAttaching(game).count;
+}
+
+static void runGenerateNextFigure(TetrisInfo_t *game) {
+  generateNextFigure(game);
+  bench_sink += game->current.fig.type;
+}
+
+// Gravity is due, so the call shifts the figure and rebuilds the frame
+static void prepareUpdate(TetrisInfo_t *game, uint64_t seed, int index) {
+  prepareMoving(game, seed, index);
+  advanceClock(game, game->update_interval);
+}
+
+static void runUpdateCurrentState(TetrisInfo_t *game) {
+  bench_sink += tetrisUpdateCurrentState(game).score;
+}
+
+static void runEvaluatePlacement(TetrisInfo_t *game) {
+  const Orientation_t *shape = figureShape(&game->current.fig);
+  int x = game->current.coordinate.x;
+  bench_sink += (long)evaluatePlacement(&kBotWeights, game->field.row, shape,
+                                        x, ghostY(game));
+}
+
+static void runBestPlacement(TetrisInfo_t *game) {
+  static BotScratch_t scratch;
+  Placement_t best;
+  bench_sink +=
+      bestPlacement(game, &kBotWeights, &scratch, &best) ? best.move.x : 0;
+}
+
+static void runGenerateMoves(TetrisInfo_t *game) {
+  static MoveGen_t gen;
+  static MoveList_t moves;
+  bench_sink += generateGameMoves(&gen, game, &moves);
+}
+
+const BenchCase_t kBenchCases[] = {
+    {"checkNewPosition", prepareMoving, runCheckNewPosition},
+    {"tryMoveFigure", prepareMoving, runTryMoveFigure},
+    {"tryRotateFigure", prepareMoving, runTryRotateFigure},
+    {"dropFigure", prepareDrop, runDropFigure},
+    {"handleAttaching/0", prepareAttaching0, runHandleAttaching},
+    {"handleAttaching/1", prepareAttaching1, runHandleAttaching},
+    {"handleAttaching/2", prepareAttaching2, runHandleAttaching},
+    {"handleAttaching/3", prepareAttaching3, runHandleAttaching},
+    {"handleAttaching/4", prepareAttaching4, runHandleAttaching},
+    {"generateNextFigure", prepareMoving, runGenerateNextFigure},
+    {"updateCurrentState", prepareUpdate, runUpdateCurrentState},
+    {"evaluatePlacement", prepareMoving, runEvaluatePlacement},
+    {"generateMoves", prepareMoving, runGenerateMoves},
+    {"bestPlacement", prepareMoving, runBestPlacement},
+};
+const int kBenchCaseCount = sizeof(kBenchCases) / sizeof(kBenchCases[0]);
+
+// A sample prepares kBenchBatch games untimed, then times one call on each
+bool runBenchCase(const BenchCase_t *bench, const BenchConfig_t *config,
+                  BenchResult_t *result) {
+  TetrisInfo_t *games = malloc(kBenchBatch * sizeof(TetrisInfo_t));
+  double *ns = malloc((config->samples > 0 ? config->samples : 1) *
+                      sizeof(double));
+  bool ok = games != NULL && ns != NULL;
+  for (int s = -config->warmup; ok && s < config->samples; s++) {
+    for (int i = 0; i < kBenchBatch; i++) {
+      bench->prepare(&games[i], config->seed, i);
+    }
+    double start = benchNowNs();
+    for (int i = 0; i < kBenchBatch; i++) {
+      bench->run(&games[i]);
+    }
+    double elapsed = benchNowNs() - start;
+    if (s >= 0) {
+      ns[s] = elapsed / kBenchBatch;
+    }
+  }
+  if (ok) {
+    result->name = bench->name;
+    result->ops = (unsigned long)config->samples * kBenchBatch;
+    result->ns_per_op = benchStats(ns, config->samples);
+  }
+  free(ns);
+  free(games);
+  return ok;
+}
+
+// Bot games from consecutive seeds over the garbage of prepareBoard(), one
+// thread, the time per piece by game
+bool runBenchGames(const BenchConfig_t *config, BenchGames_t *result) {
+  SimConfig_t sim = {.games = config->games,
+                     .threads = 1,
+                     .first_seed = config->seed,
+                     .policy = kPolicyBot,
+                     .max_pieces = 10000,
+                     .randomizer = kRandomizerUniform};
+  memset(result, 0, sizeof(*result));
+  double *ns = malloc((config->games > 0 ? config->games : 1) *
+                      sizeof(double));
+  TetrisInfo_t *game = malloc(sizeof(TetrisInfo_t));
+  SimMemory_t memory;
+  bool ok = createSimMemory(&memory, &sim) && ns != NULL && game != NULL;
+  for (int i = 0; ok && i < config->games; i++) {
+    unsigned long pieces = 0;
+    uint64_t seed = sim.first_seed + (uint64_t)i;
+    prepareBoard(game, seed);
+    double start = benchNowNs();
+    playStartedGame(game, &sim, &memory, seed, &pieces);
+    double elapsed = benchNowNs() - start;
+    ns[i] = elapsed / (pieces > 0 ? pieces : 1);
+    result->pieces += pieces;
+    result->seconds += elapsed / 1e9;
+    result->games++;
+  }
+  if (ok) {
+    result->ns_per_piece = benchStats(ns, result->games);
+  }
+  destroySimMemory(&memory);
+  free(game);
+  free(ns);
+  return ok;
+}
+
+static void printStatsJson(const BenchStats_t *stats, FILE *out) {
+  fprintf(out,
+          "{\"min\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, "
+          "\"max\": %.2f, \"mean\": %.2f}",
+          stats->min, stats->p50, stats->p90, stats->p99, stats->max,
+          stats->mean);
+}
+
+// Case names are plain identifiers, nothing needs escaping
+void printBenchJson(const BenchResult_t *results, int count,
+                    const BenchGames_t *games, FILE *out) {
+  fprintf(out, "{\n  \"batch\": %d,\n  \"benchmarks\": [", kBenchBatch);
+  for (int i = 0; i < count; i++) {
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"ops\": %lu, \"ns_per_op\": ",
+            i > 0 ? "," : "", results[i].name, results[i].ops);
+    printStatsJson(&results[i].ns_per_op, out);
+    fputc('}', out);
+  }
+  double seconds = games->seconds > 0 ? games->seconds : 1e-9;
+  fprintf(out,
+          "\n  ],\n  \"full_game\": {\"games\": %d, \"pieces\": %lu, "
+          "\"seconds\": %.4f, \"games_per_sec\": %.1f, "
+          "\"pieces_per_sec\": %.1f, \"ns_per_piece\": ",
+          games->games, games->pieces, games->seconds, games->games / seconds,
+          games->pieces / seconds);
+  printStatsJson(&games->ns_per_piece, out);
+  fputs("}\n}\n", out);
+}
+
+void printBenchTable(const BenchResult_t *results, int count,
+                     const BenchGames_t *games, FILE *out) {
+  fprintf(out, "%-20s %10s %10s %10s %10s %10s\n", "ns/op", "min", "p50",
+          "p90", "p99", "mean");
+  for (int i = 0; i < count; i++) {
+    const BenchStats_t *stats = &results[i].ns_per_op;
+    fprintf(out, "%-20s %10.1f %10.1f %10.1f %10.1f %10.1f\n", results[i].name,
+            stats->min, stats->p50, stats->p90, stats->p99, stats->mean);
+  }
+  if (games->games > 0) {
+    const BenchStats_t *stats = &games->ns_per_piece;
+    fprintf(out, "%-20s %10.1f %10.1f %10.1f %10.1f %10.1f\n", "ns/piece",
+            stats->min, stats->p50, stats->p90, stats->p99, stats->mean);
+    fprintf(out, "full games %d, %lu pieces, %.1f pieces/s\n", games->games,
+            games->pieces,
+            games->pieces / (games->seconds > 0 ? games->seconds : 1e-9));
+  }
+}
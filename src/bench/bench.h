@@ -0,0 +1,67 @@
+#ifndef BRICK_GAME_BENCH_BENCH_H_
+#define BRICK_GAME_BENCH_BENCH_H_
+
+#include "../sim/sim.h"
+
+typedef enum {
+  kBenchBatch = 256,
+  kBenchMaxSamples = 10000,
+  kBenchMaxCases = 32
+} BenchLimits_t;
+
+typedef struct {
+  int warmup;   // samples run and thrown away before measuring
+  int samples;  // each sample times kBenchBatch operations
+  int games;    // full games played for the throughput numbers
+  uint64_t seed;
+  const char *filter;  // only cases whose name contains it, NULL runs all
+} BenchConfig_t;
+
+/** Builds the game of the index-th operation of a batch, not timed */
+typedef void (*BenchPrepare_t)(TetrisInfo_t *game, uint64_t seed, int index);
+/** The timed operation */
+typedef void (*BenchRun_t)(TetrisInfo_t *game);
+
+typedef struct {
+  const char *name;
+  BenchPrepare_t prepare;
+  BenchRun_t run;
+} BenchCase_t;
+
+typedef struct {
+  double min;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+  double mean;
+} BenchStats_t;
+
+typedef struct {
+  const char *name;
+  unsigned long ops;
+  BenchStats_t ns_per_op;
+} BenchResult_t;
+
+typedef struct {
+  int games;
+  unsigned long pieces;
+  double seconds;
+  BenchStats_t ns_per_piece;  // over games
+} BenchGames_t;
+
+extern const BenchCase_t kBenchCases[];
+extern const int kBenchCaseCount;
+
+double benchNowNs(void);
+BenchStats_t benchStats(double *values, int count);
+void prepareBoard(TetrisInfo_t *game, uint64_t seed);
+bool runBenchCase(const BenchCase_t *bench, const BenchConfig_t *config,
+                  BenchResult_t *result);
+bool runBenchGames(const BenchConfig_t *config, BenchGames_t *result);
+void printBenchJson(const BenchResult_t *results, int count,
+                    const BenchGames_t *games, FILE *out);
+void printBenchTable(const BenchResult_t *results, int count,
+                     const BenchGames_t *games, FILE *out);
+
+#endif  // BRICK_GAME_BENCH_BENCH_H_
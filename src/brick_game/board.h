@@ -0,0 +1,35 @@
+#ifndef BRICK_GAME_BOARD_H_
+#define BRICK_GAME_BOARD_H_
+
+#include <stdint.h>
+
+/**
+ * Board geometry, fixed per build: make BOARD_COLS=16 BOARD_ROWS=40 ...
+ * passes -DBOARD_COLS=16 -DBOARD_ROWS=40. A row is the narrowest word that
+ * holds BOARD_COLS bits, so masks stay single words and every loop over
+ * rows or columns has a constant bound.
+ */
+#ifndef BOARD_COLS
+#define BOARD_COLS 10
+#endif
+#ifndef BOARD_ROWS
+#define BOARD_ROWS 20
+#endif
+
+// A horizontal I needs four columns, spectate.h marks rows in 64 bits
+#if BOARD_COLS < 4 || BOARD_COLS > 64
+#error "BOARD_COLS must be within 4 and 64"
+#endif
+#if BOARD_ROWS < 4 || BOARD_ROWS > 64
+#error "BOARD_ROWS must be within 4 and 64"
+#endif
+
+#if BOARD_COLS <= 16
+typedef uint16_t BoardRow_t;
+#elif BOARD_COLS <= 32
+typedef uint32_t BoardRow_t;
+#else
+typedef uint64_t BoardRow_t;
+#endif
+
+#endif  // BRICK_GAME_BOARD_H_
@@ -0,0 +1,345 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "beam.h"
+
+// Fits under the 250 ms gravity step of level 10 with room for the frame
+const BeamConfig_t kBeamDefaults = {.width = 32,
+                                    .depth = 3,
+                                    .threads = 1,
+                                    .budget_ms = 200,
+                                    .table_bytes = 4 << 20};
+
+// Score of a board that ends the game, below any real board
+static const double kLostScore = -1e9;
+
+static double clockSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Score of the board alone, the lines of the path are added by the caller
+static double boardScore(Beam_t *beam, const Row_t *rows, uint64_t hash) {
+  uint64_t bits = 0;
+  double score = 0;
+  if (beam->use_table && probeTTable(&beam->table, hash, &bits)) {
+    memcpy(&score, &bits, sizeof(score));
+  } else {
+    BoardFeatures_t features = boardFeatures(rows, 0);
+    score = scoreFeatures(&beam->weights, &features);
+    memcpy(&bits, &score, sizeof(bits));
+    if (beam->use_table) {
+      storeTTable(&beam->table, hash, bits);
+    }
+  }
+  return score;
+}
+
+// Every placement of the ply's figure on one board of the ply
+static void expandBoard(Beam_t *beam, BeamWorker_t *worker, int parent) {
+  const BeamNode_t *node = &beam->parents[parent];
+  BeamCandidate_t *out = &beam->candidates[parent * kMaxMoves];
+  int count = 0;
+  if (!node->lost) {
+    const Orientation_t *shapes = kOrientations[beam->figure];
+    generateMoves(worker->gen, node->rows, beam->figure, beam->rotation,
+                  beam->spawn, worker->moves);
+    for (int i = 0; i < worker->moves->count; i++) {
+      const Move_t *move = &worker->moves->move[i];
+      const Orientation_t *shape = &shapes[move->rotation];
+      BeamCandidate_t *candidate = &out[count++];
+      candidate->parent = parent;
+      candidate->root = beam->ply == 0 ? i : node->root;
+      candidate->rotation = move->rotation;
+      candidate->x = move->x;
+      candidate->y = move->y;
+      // Same loss rule as evaluatePlacement()
+      candidate->lost = move->y + shape->box.bottom <= 0;
+      candidate->lines = node->lines;
+      candidate->hash = node->hash;
+      candidate->score = kLostScore;
+      if (!candidate->lost) {
+        Row_t rows[kRows];
+        memcpy(rows, node->rows, sizeof(rows));
+        int lines = placeOnRows(rows, shape, move->x, move->y);
+        candidate->lines += lines;
+        candidate->hash = lines > 0 ? rowsKey(rows)
+                                    : node->hash ^
+                                          figureKey(shape, move->x, move->y);
+        candidate->score = boardScore(beam, rows, candidate->hash) +
+                           beam->weights.lines * candidate->lines;
+      }
+    }
+  }
+  beam->counts[parent] = count;
+}
+
+// Boards of the ply until none is left or the budget is spent
+static void runJob(Beam_t *beam, BeamWorker_t *worker) {
+  int parent;
+  while (!atomic_load_explicit(&beam->expired, memory_order_relaxed) &&
+         (parent = atomic_fetch_add_explicit(&beam->next_parent, 1,
+                                             memory_order_relaxed)) <
+             beam->parent_count) {
+    if (beam->deadline_sec > 0 && clockSec() > beam->deadline_sec) {
+      atomic_store_explicit(&beam->expired, true, memory_order_relaxed);
+    } else {
+      expandBoard(beam, worker, parent);
+    }
+  }
+}
+
+// Waits for a ply, runs it and waits for the next one
+static void *beamWorkerMain(void *arg) {
+  BeamWorker_t *worker = arg;
+  Beam_t *beam = worker->beam;
+  unsigned long seen = 0;
+  pthread_mutex_lock(&beam->lock);
+  while (!beam->stop) {
+    if (beam->job == seen) {
+      pthread_cond_wait(&beam->wake, &beam->lock);
+    } else {
+      seen = beam->job;
+      pthread_mutex_unlock(&beam->lock);
+      runJob(beam, worker);
+      pthread_mutex_lock(&beam->lock);
+      if (--beam->busy == 0) {
+        pthread_cond_signal(&beam->done);
+      }
+    }
+  }
+  pthread_mutex_unlock(&beam->lock);
+  return NULL;
+}
+
+// What the workers of a ply read, set while none of them runs
+static void setPly(Beam_t *beam, const BeamNode_t *parents, int count,
+                   int ply, Tetromino_t figure, Point_t spawn, int rotation) {
+  beam->parents = parents;
+  beam->parent_count = count;
+  beam->ply = ply;
+  beam->figure = figure;
+  beam->spawn = spawn;
+  beam->rotation = rotation;
+  atomic_store_explicit(&beam->next_parent, 0, memory_order_relaxed);
+}
+
+// Expands every board of the ply on all threads, false when the budget ran
+// out before the last one
+static bool expandPly(Beam_t *beam) {
+  pthread_mutex_lock(&beam->lock);
+  beam->job++;
+  beam->busy = beam->config.threads - 1;
+  pthread_cond_broadcast(&beam->wake);
+  pthread_mutex_unlock(&beam->lock);
+  runJob(beam, &beam->worker[0]);
+  pthread_mutex_lock(&beam->lock);
+  while (beam->busy > 0) {
+    pthread_cond_wait(&beam->done, &beam->lock);
+  }
+  pthread_mutex_unlock(&beam->lock);
+  return !atomic_load_explicit(&beam->expired, memory_order_relaxed);
+}
+
+// Best score first, ties keep generation order so that a run does not
+// depend on the threads
+static int compareRanks(const void *a, const void *b) {
+  const BeamRank_t *lhs = a;
+  const BeamRank_t *rhs = b;
+  int order = (lhs->score < rhs->score) - (lhs->score > rhs->score);
+  if (order == 0) {
+    order = (lhs->index > rhs->index) - (lhs->index < rhs->index);
+  }
+  return order;
+}
+
+// Keeps the width best candidates with distinct boards, returns how many
+static int selectNodes(Beam_t *beam, const BeamNode_t *parents,
+                       int parent_count, BeamNode_t *children) {
+  int total = 0;
+  for (int parent = 0; parent < parent_count; parent++) {
+    for (int i = 0; i < beam->counts[parent]; i++) {
+      int index = parent * kMaxMoves + i;
+      beam->order[total++] =
+          (BeamRank_t){.score = beam->candidates[index].score, .index = index};
+    }
+  }
+  qsort(beam->order, total, sizeof(BeamRank_t), compareRanks);
+  int kept = 0;
+  for (int i = 0; i < total && kept < beam->config.width; i++) {
+    const BeamCandidate_t *candidate =
+        &beam->candidates[beam->order[i].index];
+    bool seen = false;
+    for (int k = 0; !seen && k < kept; k++) {
+      seen = !candidate->lost && children[k].hash == candidate->hash;
+    }
+    if (!seen) {
+      const BeamNode_t *parent = &parents[candidate->parent];
+      BeamNode_t *child = &children[kept++];
+      memcpy(child->rows, parent->rows, sizeof(child->rows));
+      if (!candidate->lost) {
+        const Orientation_t *shapes = kOrientations[beam->figure];
+        placeOnRows(child->rows, &shapes[candidate->rotation], candidate->x,
+                    candidate->y);
+      }
+      child->hash = candidate->hash;
+      child->lines = candidate->lines;
+      child->root = candidate->root;
+      child->score = candidate->score;
+      child->lost = candidate->lost;
+    }
+  }
+  return kept;
+}
+
+static size_t alignedSize(size_t bytes) { return (bytes + 63) / 64 * 64; }
+
+// NULL when the config is out of range or memory or threads are short
+Beam_t *createBeam(const BeamConfig_t *config, const BotWeights_t *weights) {
+  bool ok = config->width >= 1 && config->width <= kBeamMaxWidth &&
+            config->depth >= 1 && config->threads >= 1 &&
+            config->threads <= kBeamMaxThreads;
+  Beam_t *beam = ok ? calloc(1, sizeof(Beam_t)) : NULL;
+  size_t layer = alignedSize(sizeof(BeamNode_t) * config->width);
+  size_t candidates =
+      alignedSize(sizeof(BeamCandidate_t) * config->width * kMaxMoves);
+  size_t counts = alignedSize(sizeof(int) * config->width);
+  size_t order =
+      alignedSize(sizeof(BeamRank_t) * config->width * kMaxMoves);
+  size_t roots = alignedSize(sizeof(MoveList_t));
+  size_t workers = alignedSize(sizeof(BeamWorker_t) * config->threads);
+  size_t scratch = alignedSize(sizeof(MoveGen_t)) +
+                   alignedSize(sizeof(MoveList_t));
+  if (beam) {
+    pthread_mutex_init(&beam->lock, NULL);
+    pthread_cond_init(&beam->wake, NULL);
+    pthread_cond_init(&beam->done, NULL);
+    beam->config = *config;
+    beam->config.depth =
+        config->depth < kBeamMaxDepth ? config->depth : kBeamMaxDepth;
+    beam->weights = *weights;
+    beam->arena = calloc(1, 2 * layer + candidates + counts + order + roots +
+                                workers + scratch * config->threads);
+    ok = beam->arena != NULL;
+  }
+  if (ok) {
+    char *next = beam->arena;
+    beam->layer[0] = (BeamNode_t *)next;
+    beam->layer[1] = (BeamNode_t *)(next += layer);
+    beam->candidates = (BeamCandidate_t *)(next += layer);
+    beam->counts = (int *)(next += candidates);
+    beam->order = (BeamRank_t *)(next += counts);
+    beam->roots = (MoveList_t *)(next += order);
+    beam->worker = (BeamWorker_t *)(next += roots);
+    next += workers;
+    for (int i = 0; i < config->threads; i++) {
+      beam->worker[i].beam = beam;
+      beam->worker[i].gen = (MoveGen_t *)next;
+      beam->worker[i].moves =
+          (MoveList_t *)(next + alignedSize(sizeof(MoveGen_t)));
+      next += scratch;
+    }
+    if (config->table_bytes > 0) {
+      ok = createTTable(&beam->table, config->table_bytes);
+      beam->use_table = ok;
+    }
+  }
+  for (int i = 1; ok && i < config->threads; i++) {
+    BeamWorker_t *worker = &beam->worker[i];
+    worker->started =
+        pthread_create(&worker->thread, NULL, beamWorkerMain, worker) == 0;
+    ok = worker->started;
+  }
+  if (beam && !ok) {
+    destroyBeam(beam);
+    beam = NULL;
+  }
+  return beam;
+}
+
+void destroyBeam(Beam_t *beam) {
+  pthread_mutex_lock(&beam->lock);
+  beam->stop = true;
+  pthread_cond_broadcast(&beam->wake);
+  pthread_mutex_unlock(&beam->lock);
+  for (int i = 1; beam->worker && i < beam->config.threads; i++) {
+    if (beam->worker[i].started) {
+      pthread_join(beam->worker[i].thread, NULL);
+    }
+  }
+  pthread_cond_destroy(&beam->done);
+  pthread_cond_destroy(&beam->wake);
+  pthread_mutex_destroy(&beam->lock);
+  if (beam->use_table) {
+    destroyTTable(&beam->table);
+  }
+  free(beam->arena);
+  free(beam);
+}
+
+// Drops the cached scores, so a game plays the same whatever the planner
+// searched before it
+void resetBeam(Beam_t *beam) {
+  if (beam->use_table) {
+    clearTTable(&beam->table);
+  }
+}
+
+// The first ply starts where the figure is, later ones at the spawn. A ply
+// the budget cut short is dropped, the first one always runs to the end
+bool beamPlacement(Beam_t *beam, TetrisInfo_t *game, Placement_t *best) {
+  Tetromino_t figures[kBeamMaxDepth];
+  figures[0] = game->current.fig.type;
+  int depth = 1 + peekNextFigures(game, &figures[1], beam->config.depth - 1);
+  beam->deadline_sec = beam->config.budget_ms > 0
+                           ? clockSec() + beam->config.budget_ms / 1e3
+                           : 0;
+  atomic_store_explicit(&beam->expired, false, memory_order_relaxed);
+  BeamNode_t *root = &beam->layer[1][0];
+  memcpy(root->rows, game->field.row, sizeof(root->rows));
+  root->hash = game->field.hash;
+  root->lines = 0;
+  root->root = 0;
+  root->lost = false;
+  int kept = 0;
+  if (game->state == kMoving) {
+    // One board, the calling thread keeps its moves as the roots
+    setPly(beam, root, 1, 0, figures[0], game->current.coordinate,
+           game->current.fig.rotation);
+    expandBoard(beam, &beam->worker[0], 0);
+    beam->roots->count = beam->counts[0];
+    memcpy(beam->roots->move, beam->worker[0].moves->move,
+           sizeof(Move_t) * beam->counts[0]);
+    kept = selectNodes(beam, root, 1, beam->layer[0]);
+    beam->plies++;
+  }
+  BeamNode_t *layer = beam->layer[0];
+  for (int ply = 1; ply < depth && kept > 0; ply++) {
+    BeamNode_t *next = beam->layer[ply % 2];
+    setPly(beam, layer, kept, ply, figures[ply],
+           spawnCoordinate(figures[ply]), 0);
+    int count = expandPly(beam) ? selectNodes(beam, layer, kept, next) : 0;
+    if (count > 0) {
+      layer = next;
+      kept = count;
+      beam->plies++;
+    } else {
+      ply = depth;
+    }
+  }
+  if (kept > 0) {
+    best->move = beam->roots->move[layer[0].root];
+    best->score = layer[0].score;
+  }
+  return kept > 0;
+}
+
+// Same plan format as botPlan()
+int beamPlan(Beam_t *beam, TetrisInfo_t *game, MoveCode_t *steps) {
+  Placement_t best;
+  int count = 0;
+  if (game->state == kMoving && beamPlacement(beam, game, &best)) {
+    count = placementSteps(&best, steps);
+  }
+  return count;
+}
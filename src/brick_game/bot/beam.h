@@ -0,0 +1,107 @@
+#ifndef BRICK_GAME_BOT_BEAM_H_
+#define BRICK_GAME_BOT_BEAM_H_
+
+#include <pthread.h>
+
+#include "bot.h"
+
+/**
+ * Lookahead over the falling figure and the queue behind next: every ply
+ * places one more figure on the width best boards of the ply before and
+ * keeps the width best results, equal boards once. The first placement of
+ * the best board of the last ply is played. All memory is taken when the
+ * planner is created, the worker threads live as long as it does.
+ */
+typedef enum {
+  kBeamMaxDepth = 1 + kQueueSize,  // the falling figure and the queue
+  kBeamMaxWidth = 1024,
+  kBeamMaxThreads = 64
+} BeamLimits_t;
+
+typedef struct {
+  int width;                // boards kept per ply
+  int depth;                // plies, cut to the figures the game shows
+  int threads;              // the calling thread included
+  unsigned long budget_ms;  // per decision, 0 finishes every ply
+  size_t table_bytes;       // cache of board scores, 0 is none
+} BeamConfig_t;
+
+extern const BeamConfig_t kBeamDefaults;
+
+/** A board of a ply and how it was reached */
+typedef struct {
+  Row_t rows[kRows];
+  uint64_t hash;  // rowsKey(rows)
+  int lines;      // cleared since the decision started
+  int root;       // placement of the falling figure it grew from
+  double score;
+  bool lost;
+} BeamNode_t;
+
+/** A placement on a board of the ply, made into a node once it is kept */
+typedef struct {
+  uint64_t hash;
+  double score;
+  int parent;
+  int lines;
+  int root;
+  int8_t rotation;
+  int8_t x;
+  int8_t y;
+  bool lost;
+} BeamCandidate_t;
+
+/** Sort key of a candidate */
+typedef struct {
+  double score;
+  int index;  // in candidates
+} BeamRank_t;
+
+typedef struct Beam Beam_t;
+
+typedef struct {
+  pthread_t thread;
+  Beam_t *beam;
+  MoveGen_t *gen;
+  MoveList_t *moves;
+  bool started;
+} BeamWorker_t;
+
+struct Beam {
+  BeamConfig_t config;
+  BotWeights_t weights;
+  void *arena;  // every array below lives in it
+  BeamNode_t *layer[2];
+  BeamCandidate_t *candidates;  // kMaxMoves per board of the ply
+  int *counts;                  // candidates per board of the ply
+  BeamRank_t *order;            // candidates by score
+  MoveList_t *roots;            // placements of the falling figure
+  BeamWorker_t *worker;         // worker[0] is the calling thread
+  TTable_t table;
+  bool use_table;
+  // The ply the workers run, written under lock before job grows
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  unsigned long job;
+  int busy;  // workers still on the job
+  bool stop;
+  const BeamNode_t *parents;
+  int parent_count;
+  int ply;
+  Tetromino_t figure;
+  Point_t spawn;
+  int rotation;
+  double deadline_sec;  // 0 is none
+  atomic_int next_parent;
+  atomic_bool expired;
+  unsigned long plies;  // finished ones over all decisions
+};
+
+Beam_t *createBeam(const BeamConfig_t *config, const BotWeights_t *weights);
+void destroyBeam(Beam_t *beam);
+void resetBeam(Beam_t *beam);
+bool beamPlacement(Beam_t *beam, TetrisInfo_t *game, Placement_t *best);
+int beamPlan(Beam_t *beam, TetrisInfo_t *game, MoveCode_t *steps);
+
+#endif  // BRICK_GAME_BOT_BEAM_H_
@@ -0,0 +1,119 @@
+#include "bot.h"
+
+// Weights after Yiyuan Lee's tuned four-feature player, wells added lightly
+const BotWeights_t kBotWeights = {.height = -0.510066,
+                                  .holes = -0.35663,
+                                  .bumpiness = -0.184483,
+                                  .lines = 0.760666,
+                                  .wells = -0.05};
+
+// Score of a placement that ends the game, below any real board
+static const double kLostScore = -1e9;
+
+// One pass from the top: covered marks the columns with a cell at or above
+// the line, so holes and wells of a line are a popcount each
+BoardFeatures_t boardFeatures(const Row_t *rows, int lines) {
+  BoardFeatures_t features = {.lines = lines};
+  int height[kCols] = {0};
+  Row_t covered = 0;
+  for (int line = 0; line < kRows; line++) {
+    Row_t row = rows[line];
+    for (Row_t fresh = row & (Row_t)~covered; fresh; fresh &= fresh - 1) {
+      height[__builtin_ctzll(fresh)] = kRows - line;
+    }
+    features.holes += __builtin_popcountll(covered & (Row_t)~row);
+    covered |= row;
+    // The walls count as filled neighbors
+    Row_t left = (Row_t)(covered << 1 | 1u);
+    Row_t right = (Row_t)(covered >> 1 | (Row_t)1 << (kCols - 1));
+    features.wells +=
+        __builtin_popcountll((Row_t)~covered & FULL_ROW & left & right);
+  }
+  for (int column = 0; column < kCols; column++) {
+    features.height += height[column];
+    if (column > 0) {
+      int step = height[column] - height[column - 1];
+      features.bumpiness += step < 0 ? -step : step;
+    }
+  }
+  return features;
+}
+
+double scoreFeatures(const BotWeights_t *weights,
+                     const BoardFeatures_t *features) {
+  return weights->height * features->height +
+         weights->holes * features->holes +
+         weights->bumpiness * features->bumpiness +
+         weights->lines * features->lines + weights->wells * features->wells;
+}
+
+// Locks a figure into bare rows and removes the full ones, returns how many
+int placeOnRows(Row_t *rows, const Orientation_t *shape, int x, int y) {
+  int lines = 0;
+  for (int i = shape->box.top; i <= shape->box.bottom; i++) {
+    if (y + i >= 0) {
+      rows[y + i] |= shiftRowMask(shape->row[i], x);
+      lines += rows[y + i] == FULL_ROW;
+    }
+  }
+  if (lines > 0) {
+    int write = y + shape->box.bottom;
+    for (int read = write; read >= 0; read--) {
+      if (rows[read] != FULL_ROW) {
+        rows[write--] = rows[read];
+      }
+    }
+    for (; write >= 0; write--) {
+      rows[write] = 0;
+    }
+  }
+  return lines;
+}
+
+// Same loss rule as checkGameOver(): the lowest cell lands in row 0 or above
+double evaluatePlacement(const BotWeights_t *weights, const Row_t *field,
+                         const Orientation_t *shape, int x, int y) {
+  double score = kLostScore;
+  if (y + shape->box.bottom > 0) {
+    Row_t rows[kRows];
+    memcpy(rows, field, sizeof(rows));
+    int lines = placeOnRows(rows, shape, x, y);
+    BoardFeatures_t features = boardFeatures(rows, lines);
+    score = scoreFeatures(weights, &features);
+  }
+  return score;
+}
+
+// Every placement generateMoves() reaches, under overhangs too
+bool bestPlacement(const TetrisInfo_t *game, const BotWeights_t *weights,
+                   BotScratch_t *scratch, Placement_t *best) {
+  MoveList_t *moves = &scratch->moves;
+  generateGameMoves(&scratch->gen, game, moves);
+  const Orientation_t *shapes = kOrientations[game->current.fig.type];
+  for (int i = 0; i < moves->count; i++) {
+    const Move_t *move = &moves->move[i];
+    double score = evaluatePlacement(weights, game->field.row,
+                                     &shapes[move->rotation], move->x, move->y);
+    if (i == 0 || score > best->score) {
+      best->move = *move;
+      best->score = score;
+    }
+  }
+  return moves->count > 0;
+}
+
+int placementSteps(const Placement_t *placement, MoveCode_t *steps) {
+  return moveSteps(&placement->move, steps);
+}
+
+// Steps that land the current figure on the best spot, at most kBotMaxPlan
+// of them. moveInput() gives the key of each, a fall waits for gravity
+int botPlan(const TetrisInfo_t *game, const BotWeights_t *weights,
+            BotScratch_t *scratch, MoveCode_t *steps) {
+  Placement_t best;
+  int count = 0;
+  if (game->state == kMoving && bestPlacement(game, weights, scratch, &best)) {
+    count = placementSteps(&best, steps);
+  }
+  return count;
+}
@@ -0,0 +1,55 @@
+#ifndef BRICK_GAME_BOT_BOT_H_
+#define BRICK_GAME_BOT_BOT_H_
+
+#include "../tetris/tetris.h"
+#include "movegen.h"
+#include "ttable.h"
+
+/** Steps of one placement, see Move_t */
+typedef enum { kBotMaxPlan = kMovePathMax } BotLimits_t;
+
+/** What the heuristic looks at, see boardFeatures() */
+typedef struct {
+  int height;     // sum of the column heights
+  int holes;      // empty cells with a landed cell above them
+  int bumpiness;  // sum of the height steps between neighbor columns
+  int lines;      // lines the placement has cleared
+  int wells;      // open cells with both neighbors filled or a wall
+} BoardFeatures_t;
+
+/** A board scores the weighted sum of its features, higher is better */
+typedef struct {
+  double height;
+  double holes;
+  double bumpiness;
+  double lines;
+  double wells;
+} BotWeights_t;
+
+extern const BotWeights_t kBotWeights;
+
+typedef struct {
+  Move_t move;
+  double score;
+} Placement_t;
+
+/** Memory of the move search, far too big for a thread's stack on large
+ * boards, so the caller owns it */
+typedef struct {
+  MoveGen_t gen;
+  MoveList_t moves;
+} BotScratch_t;
+
+BoardFeatures_t boardFeatures(const Row_t *rows, int lines);
+double scoreFeatures(const BotWeights_t *weights,
+                     const BoardFeatures_t *features);
+int placeOnRows(Row_t *rows, const Orientation_t *shape, int x, int y);
+double evaluatePlacement(const BotWeights_t *weights, const Row_t *field,
+                         const Orientation_t *shape, int x, int y);
+bool bestPlacement(const TetrisInfo_t *game, const BotWeights_t *weights,
+                   BotScratch_t *scratch, Placement_t *best);
+int placementSteps(const Placement_t *placement, MoveCode_t *steps);
+int botPlan(const TetrisInfo_t *game, const BotWeights_t *weights,
+            BotScratch_t *scratch, MoveCode_t *steps);
+
+#endif  // BRICK_GAME_BOT_BOT_H_
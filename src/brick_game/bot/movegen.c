@@ -0,0 +1,196 @@
+#include "movegen.h"
+
+static const UserAction_t kMoveActions[] = {Left, Right, Action, Down};
+
+static int stateIndex(int rotation, int x, int y) {
+  return (rotation * kMoveYs + y + kFigRows) * kMoveXs + x + kFigCols;
+}
+
+static bool testBit(const uint64_t *bits, int index) {
+  return bits[index >> 6] >> (index & 63) & 1;
+}
+
+static void setBit(uint64_t *bits, int index) {
+  bits[index >> 6] |= (uint64_t)1 << (index & 63);
+}
+
+// Same rows once moved to the top left corner of the box
+static bool sameCells(const Orientation_t *a, const Orientation_t *b) {
+  bool same = a->box.bottom - a->box.top == b->box.bottom - b->box.top;
+  for (int i = 0; same && i <= a->box.bottom - a->box.top; i++) {
+    same = a->row[a->box.top + i] >> a->box.left ==
+           b->row[b->box.top + i] >> b->box.left;
+  }
+  return same;
+}
+
+// figureFits() for the search, the box bounds replace the wall tests
+static inline bool fitsAt(const Row_t *field, const Orientation_t *shape,
+                          int x, int y) {
+  bool fits = x + shape->box.left >= 0 && x + shape->box.right < kCols &&
+              y + shape->box.bottom < kRows;
+  for (int i = shape->box.top; fits && i <= shape->box.bottom; i++) {
+    Row_t mask = (Row_t)(x < 0 ? shape->row[i] >> -x : shape->row[i] << x);
+    fits = y + i < 0 || (field[y + i] & mask) == 0;
+  }
+  return fits;
+}
+
+// Same as dropDistance() with the first filled row of each column as top,
+// the slow walk is left for figures under an overhang
+static int landingRow(const Row_t *field, const int *top,
+                      const Orientation_t *shape, int x, int y) {
+  int distance = kRows;
+  for (int k = 0; k < kFigCells; k++) {
+    int free_rows = top[x + shape->cell[k].x] - 1 - (y + shape->cell[k].y);
+    distance = free_rows < distance ? free_rows : distance;
+  }
+  if (distance < 0) {
+    for (distance = 0; fitsAt(field, shape, x, y + distance + 1);
+         distance++) {
+    }
+  }
+  return y + distance;
+}
+
+// Queues (rotation, x, y) once, when the figure fits there
+static void visit(MoveGen_t *gen, const Row_t *field,
+                  const Orientation_t *shapes, int rotation, int x, int y,
+                  int from, MoveCode_t code, int *tail) {
+  if (fitsAt(field, &shapes[rotation], x, y)) {
+    int state = stateIndex(rotation, x, y);
+    if (!testBit(gen->visited, state)) {
+      setBit(gen->visited, state);
+      gen->parent[state] = (uint16_t)from;
+      gen->code[state] = (uint8_t)code;
+      gen->depth[state] = (uint8_t)(gen->depth[from] + 1);
+      gen->queue[(*tail)++] = (uint16_t)state;
+    }
+  }
+}
+
+static void listMove(const MoveGen_t *gen, int state, int rotation, int x,
+                     int y, MoveList_t *moves) {
+  Move_t *move = &moves->move[moves->count++];
+  memset(move, 0, sizeof(*move));
+  move->rotation = (int8_t)rotation;
+  move->x = (int8_t)x;
+  move->y = (int8_t)y;
+  move->length = gen->depth[state];
+  for (int i = move->length - 1; i >= 0; i--) {
+    move->path[i / kMoveCodesPerWord] |=
+        (uint64_t)gen->code[state] << (kMoveCodeBits * (i % kMoveCodesPerWord));
+    state = gen->parent[state];
+  }
+}
+
+// Rotations with equal cells are one placement, kept under the first one
+int generateMoves(MoveGen_t *gen, const Row_t *field, Tetromino_t type,
+                  int rotation, Point_t spawn, MoveList_t *moves) {
+  const Orientation_t *shapes = kOrientations[type];
+  int same[kRotations];
+  for (int r = 0; r < kRotations; r++) {
+    same[r] = r;
+    for (int first = r - 1; first >= 0; first--) {
+      same[r] = sameCells(&shapes[r], &shapes[first]) ? first : same[r];
+    }
+  }
+  int top[kCols];
+  Row_t seen = 0;
+  for (int column = 0; column < kCols; column++) {
+    top[column] = kRows;
+  }
+  for (int line = 0; line < kRows && seen != FULL_ROW; line++) {
+    for (Row_t fresh = field[line] & (Row_t)~seen; fresh; fresh &= fresh - 1) {
+      top[__builtin_ctzll(fresh)] = line;
+    }
+    seen |= field[line];
+  }
+  // Rows above the first open cell with a filled one over it hold no
+  // overhang, a figure in them moves the same before and after a fall
+  int covered = kRows;
+  Row_t roof = 0;
+  for (int line = 0; line < kRows && covered == kRows; line++) {
+    covered = (roof & (Row_t)~field[line]) ? line : kRows;
+    roof |= field[line];
+  }
+  memset(gen->visited, 0, sizeof(gen->visited));
+  memset(gen->placed, 0, sizeof(gen->placed));
+  moves->count = 0;
+  int head = 0;
+  int tail = 0;
+  bool spawned = spawn.y >= -kFigRows &&
+                 fitsAt(field, &shapes[rotation], spawn.x, spawn.y);
+  if (spawned) {
+    int start = stateIndex(rotation, spawn.x, spawn.y);
+    setBit(gen->visited, start);
+    gen->depth[start] = 0;
+    gen->code[start] = kMoveDrop;
+    gen->queue[tail++] = (uint16_t)start;
+  }
+  while (head < tail) {
+    int state = gen->queue[head++];
+    int r = state / (kMoveXs * kMoveYs);
+    int y = state / kMoveXs % kMoveYs - kFigRows;
+    int x = state % kMoveXs - kFigCols;
+    const Orientation_t *shape = &shapes[r];
+    bool resting = !fitsAt(field, shape, x, y + 1);
+    if (resting) {
+      const Orientation_t *first = &shapes[same[r]];
+      int placed = stateIndex(same[r], x + shape->box.left - first->box.left,
+                              y + shape->box.top - first->box.top);
+      if (!testBit(gen->placed, placed)) {
+        setBit(gen->placed, placed);
+        listMove(gen, state, r, x, y, moves);
+      }
+    }
+    // The parent of a fall above the covered rows had the same moves, for
+    // any rotation of the 4x4 box
+    bool passing = gen->code[state] == kMoveFall && y + kFigRows <= covered;
+    if (gen->depth[state] < kMovePathMax && !passing) {
+      visit(gen, field, shapes, r, x - 1, y, state, kMoveLeft, &tail);
+      visit(gen, field, shapes, r, x + 1, y, state, kMoveRight, &tail);
+      visit(gen, field, shapes, (r + 1) % kRotations, x, y, state, kMoveTurn,
+            &tail);
+      if (!resting) {
+        int landing = landingRow(field, top, shape, x, y);
+        visit(gen, field, shapes, r, x, landing, state, kMoveDrop, &tail);
+      }
+    }
+    if (gen->depth[state] < kMovePathMax && !resting && covered < kRows) {
+      visit(gen, field, shapes, r, x, y + 1, state, kMoveFall, &tail);
+    }
+  }
+  return moves->count;
+}
+
+// Placements of the falling figure, none unless the game is moving
+int generateGameMoves(MoveGen_t *gen, const TetrisInfo_t *game,
+                      MoveList_t *moves) {
+  moves->count = 0;
+  if (game->state == kMoving) {
+    generateMoves(gen, game->field.row, game->current.fig.type,
+                  game->current.fig.rotation, game->current.coordinate, moves);
+  }
+  return moves->count;
+}
+
+// The path of a move unpacked, move->length steps
+int moveSteps(const Move_t *move, MoveCode_t *steps) {
+  for (int i = 0; i < move->length; i++) {
+    uint64_t word = move->path[i / kMoveCodesPerWord];
+    steps[i] = (MoveCode_t)(word >> (kMoveCodeBits * (i % kMoveCodesPerWord)) &
+                            7u);
+  }
+  return move->length;
+}
+
+// Key of a step for userInput(), false for a fall: the player waits for
+// the next gravity step there, however its game keeps time
+bool moveInput(MoveCode_t step, UserAction_t *action) {
+  bool key = step != kMoveFall;
+  if (key) {
+    *action = kMoveActions[step];
+  }
+  return key;
+}
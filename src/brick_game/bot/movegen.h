@@ -0,0 +1,72 @@
+#ifndef BRICK_GAME_BOT_MOVEGEN_H_
+#define BRICK_GAME_BOT_MOVEGEN_H_
+
+#include "../tetris/tetris.h"
+
+/**
+ * Every placement a figure can reach from its spawn under the rules of
+ * tetrisUserInput(): Left and Right slide by one column, Action turns in
+ * place without kicks, Down drops to the landing row and leaves the figure
+ * movable until the next gravity step, so it can still slide under an
+ * overhang. A gravity step moves the figure one row, so it can also slide
+ * or turn under an overhang on its way down; above the first covered open
+ * cell that reaches nothing a drop does not, so falls there only lead down.
+ * A state is (rotation, x, y) of the 4x4 box, the search is a breadth first
+ * walk over them, so each path is a shortest one.
+ */
+typedef enum {
+  kMoveXs = kCols + kFigCols,  // x from -kFigCols to kCols - 1
+  kMoveYs = kRows + kFigRows,  // y from -kFigRows to kRows - 1
+  kMoveStates = kRotations * kMoveXs * kMoveYs,
+  // Two landing rows of one rotation and column have a blocked row between
+  kMaxMoves = kRotations * kMoveXs * ((kMoveYs + 1) / 2),
+  kMovePathMax = kCols + kRows + 8,  // slides, turns and falls
+  kMoveCodeBits = 3,
+  kMoveCodesPerWord = 64 / kMoveCodeBits,
+  kMovePathWords = (kMovePathMax + kMoveCodesPerWord - 1) / kMoveCodesPerWord,
+  kMoveBitsetWords = (kMoveStates + 63) / 64
+} MoveGenLimits_t;
+
+_Static_assert(kMoveStates <= UINT16_MAX, "states are indexed by uint16_t");
+
+/** Steps of a path, kMoveFall waits for a gravity step instead of a key */
+typedef enum {
+  kMoveLeft,
+  kMoveRight,
+  kMoveTurn,
+  kMoveDrop,
+  kMoveFall
+} MoveCode_t;
+
+/** A resting figure, the engine locks it on the next gravity step */
+typedef struct {
+  int8_t rotation;
+  int8_t x;
+  int8_t y;
+  uint8_t length;                 // steps from the spawn
+  uint64_t path[kMovePathWords];  // kMoveCodeBits per MoveCode_t
+} Move_t;
+
+typedef struct {
+  int count;
+  Move_t move[kMaxMoves];
+} MoveList_t;
+
+/** Scratch memory of generateMoves(), no heap is used */
+typedef struct {
+  uint64_t visited[kMoveBitsetWords];
+  uint64_t placed[kMoveBitsetWords];  // cells listed already, any rotation
+  uint16_t queue[kMoveStates];
+  uint16_t parent[kMoveStates];
+  uint8_t code[kMoveStates];
+  uint8_t depth[kMoveStates];
+} MoveGen_t;
+
+int generateMoves(MoveGen_t *gen, const Row_t *field, Tetromino_t type,
+                  int rotation, Point_t spawn, MoveList_t *moves);
+int generateGameMoves(MoveGen_t *gen, const TetrisInfo_t *game,
+                      MoveList_t *moves);
+int moveSteps(const Move_t *move, MoveCode_t *steps);
+bool moveInput(MoveCode_t step, UserAction_t *action);
+
+#endif  // BRICK_GAME_BOT_MOVEGEN_H_
@@ -0,0 +1,64 @@
+#include "ttable.h"
+
+// Rounds bytes down to a power of two of buckets, at least one
+bool createTTable(TTable_t *table, size_t bytes) {
+  size_t count = 1;
+  while (count * 2 * sizeof(TTableBucket_t) <= bytes) {
+    count *= 2;
+  }
+  table->bucket = aligned_alloc(sizeof(TTableBucket_t),
+                                count * sizeof(TTableBucket_t));
+  table->mask = table->bucket ? count - 1 : 0;
+  if (table->bucket) {
+    clearTTable(table);
+  }
+  return table->bucket != NULL;
+}
+
+void destroyTTable(TTable_t *table) {
+  free(table->bucket);
+  table->bucket = NULL;
+  table->mask = 0;
+}
+
+// Not safe against concurrent stores, call it between searches
+void clearTTable(TTable_t *table) {
+  memset(table->bucket, 0, (table->mask + 1) * sizeof(TTableBucket_t));
+}
+
+static TTableBucket_t *bucketOf(const TTable_t *table, uint64_t key) {
+  return &table->bucket[key & table->mask];
+}
+
+// A zero key is never found, empty entries look like it
+bool probeTTable(const TTable_t *table, uint64_t key, uint64_t *data) {
+  TTableBucket_t *bucket = bucketOf(table, key);
+  bool found = false;
+  for (int way = 0; !found && way < kTTableWays; way++) {
+    TTableEntry_t *entry = &bucket->entry[way];
+    uint64_t value =
+        atomic_load_explicit(&entry->data, memory_order_relaxed);
+    uint64_t check =
+        atomic_load_explicit(&entry->check, memory_order_relaxed);
+    found = key != 0 && (check ^ value) == key;
+    *data = found ? value : *data;
+  }
+  return found;
+}
+
+// Overwrites the way holding the key, or the one the high key bits pick
+void storeTTable(TTable_t *table, uint64_t key, uint64_t data) {
+  TTableBucket_t *bucket = bucketOf(table, key);
+  int victim = (int)(key >> 62) % kTTableWays;
+  for (int way = 0; way < kTTableWays; way++) {
+    TTableEntry_t *entry = &bucket->entry[way];
+    uint64_t value =
+        atomic_load_explicit(&entry->data, memory_order_relaxed);
+    uint64_t check =
+        atomic_load_explicit(&entry->check, memory_order_relaxed);
+    victim = (check ^ value) == key ? way : victim;
+  }
+  TTableEntry_t *entry = &bucket->entry[victim];
+  atomic_store_explicit(&entry->check, key ^ data, memory_order_relaxed);
+  atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+}
@@ -0,0 +1,35 @@
+#ifndef BRICK_GAME_BOT_TTABLE_H_
+#define BRICK_GAME_BOT_TTABLE_H_
+
+#include "../tetris/tetris.h"
+
+/**
+ * Fixed size cache of 64-bit values keyed by board hashes, shared by any
+ * number of threads without locks. An entry keeps key ^ data next to data,
+ * both written with relaxed stores: a probe that sees the halves of two
+ * different stores gets a key that does not match and reports a miss.
+ */
+typedef enum { kTTableWays = 4 } TTableLimits_t;
+
+typedef struct {
+  atomic_ullong check;  // key ^ data
+  atomic_ullong data;
+} TTableEntry_t;
+
+/** One cache line, a key may sit in any of its ways */
+typedef struct {
+  _Alignas(64) TTableEntry_t entry[kTTableWays];
+} TTableBucket_t;
+
+typedef struct {
+  TTableBucket_t *bucket;
+  uint64_t mask;  // bucket count - 1, the count is a power of two
+} TTable_t;
+
+bool createTTable(TTable_t *table, size_t bytes);
+void destroyTTable(TTable_t *table);
+void clearTTable(TTable_t *table);
+bool probeTTable(const TTable_t *table, uint64_t key, uint64_t *data);
+void storeTTable(TTable_t *table, uint64_t key, uint64_t data);
+
+#endif  // BRICK_GAME_BOT_TTABLE_H_
@@ -2,6 +2,13 @@
 #define BRICK_GAME_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+#define FRAME_ROWS BOARD_ROWS
+#define FRAME_COLS BOARD_COLS
+#define FRAME_NEXT 4
 
 typedef enum {
   Start,
@@ -24,7 +31,29 @@ typedef struct {
   int pause;
 } GameInfo_t;
 
+/** Packed picture of a game, bit j of a row is column j */
+typedef struct {
+  unsigned long version;  // getStateVersion() of the game it shows
+  BoardRow_t field[FRAME_ROWS];
+  uint32_t next[FRAME_NEXT];
+  int score;
+  int high_score;
+  int level;
+  int speed;
+  int pause;
+  bool running;  // false once the player has quit
+} Frame_t;
+
 void userInput(UserAction_t action, bool hold);
 GameInfo_t updateCurrentState();
+/** updateCurrentState() without the int** copy, read only, valid until the
+ * next call */
+const Frame_t *updateFrame();
+/** Grows with every change of what updateCurrentState() returns */
+unsigned long getStateVersion();
+/** Zobrist hash of the landed cells, equal boards have equal hashes */
+uint64_t getBoardHash();
+/** Milliseconds until updateCurrentState() has work, -1 if only input can */
+long getUpdateDelayMs();
 
 #endif  // BRICK_GAME_H_
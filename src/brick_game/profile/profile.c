@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "profile.h"
+
+#include <string.h>
+#include <time.h>
+
+static const char *const kPointNames[kProfilePoints] = {
+    "userInput",  "updateCurrentState", "handleAttaching",
+    "dropFigure", "getAction",          "showState"};
+
+static const char *const kHistogramNames[kHistograms] = {"input-to-render",
+                                                         "frame time"};
+
+uint64_t profileNowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+ProfileStats_t *getProfileStats(void) {
+  static ProfileStats_t stats;
+  return &stats;
+}
+
+void resetProfileStats(void) {
+  memset(getProfileStats(), 0, sizeof(ProfileStats_t));
+}
+
+void profileCount(ProfilePoint_t point, uint64_t ns) {
+  ProfileCounter_t *counter = &getProfileStats()->counter[point];
+  counter->calls++;
+  counter->total_ns += ns;
+  if (ns > counter->max_ns) {
+    counter->max_ns = ns;
+  }
+}
+
+void profileRecord(ProfileHistogram_t histogram, uint64_t ns) {
+  histogramAdd(&getProfileStats()->histogram[histogram], ns);
+}
+
+// Only the oldest key counts, the keys after it are drawn in the same frame
+void profileMarkInput(void) {
+  ProfileStats_t *stats = getProfileStats();
+  if (stats->input_ns == 0) {
+    stats->input_ns = profileNowNs();
+  }
+}
+
+void profileMarkRender(void) {
+  ProfileStats_t *stats = getProfileStats();
+  if (stats->input_ns != 0) {
+    profileRecord(kHistogramInputToRender, profileNowNs() - stats->input_ns);
+    stats->input_ns = 0;
+  }
+}
+
+// Values below 2 * kHistogramSubCount have a bucket each, above that every
+// power of two is split into kHistogramSubCount buckets
+int histogramIndex(uint64_t ns) {
+  ns = ns < kHistogramMaxNs ? ns : kHistogramMaxNs - 1;
+  int magnitude = 63 - __builtin_clzll(ns | 1) - kHistogramSubBits;
+  magnitude = magnitude > 0 ? magnitude : 0;
+  return magnitude * kHistogramSubCount + (int)(ns >> magnitude);
+}
+
+// Largest value that falls into the bucket
+uint64_t histogramValue(int index) {
+  int magnitude = index < 2 * kHistogramSubCount
+                      ? 0
+                      : index / kHistogramSubCount - 1;
+  uint64_t sub = (uint64_t)(index - magnitude * kHistogramSubCount);
+  return ((sub + 1) << magnitude) - 1;
+}
+
+void histogramAdd(Histogram_t *histogram, uint64_t ns) {
+  histogram->bucket[histogramIndex(ns)]++;
+  histogram->count++;
+  if (ns > histogram->max_ns) {
+    histogram->max_ns = ns;
+  }
+}
+
+uint64_t histogramPercentile(const Histogram_t *histogram, double percent) {
+  uint64_t rank = (uint64_t)(histogram->count * percent / 100.0 + 0.5);
+  rank = rank > 0 ? rank : 1;
+  uint64_t seen = 0;
+  int index = 0;
+  for (; index < kHistogramBuckets && seen < rank; index++) {
+    seen += histogram->bucket[index];
+  }
+  uint64_t value = histogram->count > 0 ? histogramValue(index - 1) : 0;
+  return value < histogram->max_ns ? value : histogram->max_ns;
+}
+
+void dumpProfileStats(FILE *out) {
+  const ProfileStats_t *stats = getProfileStats();
+  fprintf(out, "%-20s %10s %12s %10s %10s\n", "point", "calls", "total us",
+          "mean ns", "max ns");
+  for (int i = 0; i < kProfilePoints; i++) {
+    const ProfileCounter_t *counter = &stats->counter[i];
+    fprintf(out, "%-20s %10lu %12.1f %10.0f %10llu\n", kPointNames[i],
+            counter->calls, counter->total_ns / 1e3,
+            counter->calls ? (double)counter->total_ns / counter->calls : 0.0,
+            (unsigned long long)counter->max_ns);
+  }
+  fprintf(out, "%-20s %10s %10s %10s %10s %10s\n", "histogram us", "count",
+          "p50", "p90", "p99", "max");
+  for (int i = 0; i < kHistograms; i++) {
+    const Histogram_t *histogram = &stats->histogram[i];
+    fprintf(out, "%-20s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+            kHistogramNames[i], (unsigned long long)histogram->count,
+            histogramPercentile(histogram, 50) / 1e3,
+            histogramPercentile(histogram, 90) / 1e3,
+            histogramPercentile(histogram, 99) / 1e3,
+            histogram->max_ns / 1e3);
+  }
+}
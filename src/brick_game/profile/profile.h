@@ -0,0 +1,93 @@
+#ifndef BRICK_GAME_PROFILE_PROFILE_H_
+#define BRICK_GAME_PROFILE_PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Hot path counters and latency histograms, built with -DPROFILE only.
+ * Without it the PROFILE_* macros expand to nothing and no code is left.
+ * The stats are process wide and not synchronized, profile one game per
+ * process.
+ */
+
+typedef enum {
+  kProfileUserInput,
+  kProfileUpdateCurrentState,
+  kProfileHandleAttaching,
+  kProfileDropFigure,
+  kProfileGetAction,
+  kProfileShowState,
+  kProfilePoints
+} ProfilePoint_t;
+
+typedef enum {
+  kHistogramInputToRender,  // key read until the frame showing it is drawn
+  kHistogramFrameTime,      // update, draw and refresh of a drawn frame
+  kHistograms
+} ProfileHistogram_t;
+
+// Log-linear buckets as in HdrHistogram: 2^kHistogramSubBits steps per
+// power of two keep about 3% precision from 1 ns up to kHistogramMaxNs
+typedef enum {
+  kHistogramSubBits = 5,
+  kHistogramSubCount = 1 << kHistogramSubBits,
+  kHistogramMagnitudes = 36,
+  kHistogramBuckets = (kHistogramMagnitudes + 1) * kHistogramSubCount
+} HistogramLayout_t;
+
+#define kHistogramMaxNs \
+  ((uint64_t)1 << (kHistogramMagnitudes + kHistogramSubBits))
+
+typedef struct {
+  unsigned long calls;
+  uint64_t total_ns;
+  uint64_t max_ns;
+} ProfileCounter_t;
+
+typedef struct {
+  uint64_t count;
+  uint64_t max_ns;
+  uint64_t bucket[kHistogramBuckets];
+} Histogram_t;
+
+typedef struct {
+  ProfileCounter_t counter[kProfilePoints];
+  Histogram_t histogram[kHistograms];
+  uint64_t input_ns;  // time of the oldest key not drawn yet, 0 if none
+} ProfileStats_t;
+
+uint64_t profileNowNs(void);
+ProfileStats_t *getProfileStats(void);
+void resetProfileStats(void);
+void profileCount(ProfilePoint_t point, uint64_t ns);
+void profileRecord(ProfileHistogram_t histogram, uint64_t ns);
+void profileMarkInput(void);
+void profileMarkRender(void);
+
+int histogramIndex(uint64_t ns);
+uint64_t histogramValue(int index);
+void histogramAdd(Histogram_t *histogram, uint64_t ns);
+uint64_t histogramPercentile(const Histogram_t *histogram, double percent);
+void dumpProfileStats(FILE *out);
+
+#ifdef PROFILE
+#define PROFILE_START(name) uint64_t name##_start_ns = profileNowNs()
+#define PROFILE_STOP(name, point) \
+  profileCount((point), profileNowNs() - name##_start_ns)
+#define PROFILE_SAMPLE(name, histogram) \
+  profileRecord((histogram), profileNowNs() - name##_start_ns)
+#define PROFILE_INPUT() profileMarkInput()
+#define PROFILE_RENDERED() profileMarkRender()
+#define PROFILE_DUMP(out) dumpProfileStats(out)
+#else
+#define PROFILE_START(name) ((void)0)
+#define PROFILE_STOP(name, point) ((void)0)
+#define PROFILE_SAMPLE(name, histogram) ((void)0)
+#define PROFILE_INPUT() ((void)0)
+#define PROFILE_RENDERED() ((void)0)
+#define PROFILE_DUMP(out) ((void)0)
+#endif  // PROFILE
+
+#endif  // BRICK_GAME_PROFILE_PROFILE_H_
@@ -0,0 +1,245 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "highscore.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char kMagic[] = "BGS";
+
+/** Background writer, the game thread only queues entries for it */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t thread;
+  bool running;
+  bool stop;
+  int count;
+  ScoreEntry_t queue[kScoresQueueSize];
+  char path[kScoresPathSize];
+} ScoresWriter_t;
+
+static ScoresWriter_t *getScoresWriter() {
+  static ScoresWriter_t writer = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                                  .wake = PTHREAD_COND_INITIALIZER};
+  return &writer;
+}
+
+static char *scoresPath() {
+  static char path[kScoresPathSize];
+  return path;
+}
+
+// $BRICK_GAME_SCORES, else ~/.brick_game_scores, not the working directory
+const char *getScoresPath(void) {
+  char *path = scoresPath();
+  if (path[0] == '\0') {
+    const char *env = getenv("BRICK_GAME_SCORES");
+    const char *home = getenv("HOME");
+    if (env && env[0]) {
+      snprintf(path, kScoresPathSize, "%s", env);
+    } else {
+      snprintf(path, kScoresPathSize, "%s/.brick_game_scores",
+               home && home[0] ? home : ".");
+    }
+  }
+  return path;
+}
+
+// Call before the first postScore(), the writer keeps the path it started with
+void setScoresPath(const char *path) {
+  snprintf(scoresPath(), kScoresPathSize, "%s", path);
+}
+
+static uint32_t hashBytes(const uint8_t *bytes, int size) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static void putLittleEndian(uint8_t *bytes, uint64_t value, int size) {
+  for (int i = 0; i < size; i++) {
+    bytes[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint64_t getLittleEndian(const uint8_t *bytes, int size) {
+  uint64_t value = 0;
+  for (int i = 0; i < size; i++) {
+    value |= (uint64_t)bytes[i] << (8 * i);
+  }
+  return value;
+}
+
+// False when the entry is too low for the board
+bool insertScore(Leaderboard_t *board, ScoreEntry_t entry) {
+  int place = 0;
+  while (place < board->count && board->entry[place].score >= entry.score) {
+    place++;
+  }
+  bool inserted = place < kLeaderboardSize;
+  if (inserted) {
+    int moved = board->count - place - (board->count == kLeaderboardSize);
+    memmove(&board->entry[place + 1], &board->entry[place],
+            moved * sizeof(ScoreEntry_t));
+    board->entry[place] = entry;
+    board->count += board->count < kLeaderboardSize;
+  }
+  return inserted;
+}
+
+// A missing, short or damaged file gives an empty board and false
+bool readLeaderboard(const char *path, Leaderboard_t *board) {
+  uint8_t bytes[kScoresFileBytes + 1];
+  FILE *file = fopen(path, "rb");
+  int size = 0;
+  if (file) {
+    size = (int)fread(bytes, 1, sizeof(bytes), file);
+    fclose(file);
+  }
+  memset(board, 0, sizeof(*board));
+  int count = size > kScoresHeaderBytes ? bytes[4] : 0;
+  int body = kScoresHeaderBytes + count * kScoreEntryBytes;
+  bool ok = size > kScoresHeaderBytes && memcmp(bytes, kMagic, 3) == 0 &&
+            bytes[3] == kScoresVersion && count <= kLeaderboardSize &&
+            size == body + 4 &&
+            getLittleEndian(&bytes[body], 4) == hashBytes(bytes, body);
+  for (int i = 0; ok && i < count; i++) {
+    const uint8_t *entry = &bytes[kScoresHeaderBytes + i * kScoreEntryBytes];
+    board->entry[i].score = (uint32_t)getLittleEndian(entry, 4);
+    board->entry[i].time = getLittleEndian(entry + 4, 8);
+  }
+  board->count = ok ? count : 0;
+  return ok;
+}
+
+// Writes a temporary file next to path and renames it over path
+// Makes a rename() in the directory of path survive a crash
+static bool syncParentDir(const char *path) {
+  char dir[kScoresPathSize];
+  snprintf(dir, sizeof(dir), "%s", path);
+  char *slash = strrchr(dir, '/');
+  if (slash == NULL) {
+    snprintf(dir, sizeof(dir), ".");
+  } else {
+    slash[slash == dir] = '\0';  // keeps the root as "/"
+  }
+  int fd = open(dir, O_RDONLY | O_DIRECTORY);
+  bool ok = fd >= 0 && fsync(fd) == 0;
+  if (fd >= 0) {
+    close(fd);
+  }
+  return ok;
+}
+
+bool writeLeaderboard(const char *path, const Leaderboard_t *board) {
+  uint8_t bytes[kScoresFileBytes];
+  memcpy(bytes, kMagic, 3);
+  bytes[3] = kScoresVersion;
+  bytes[4] = (uint8_t)board->count;
+  int body = kScoresHeaderBytes + board->count * kScoreEntryBytes;
+  for (int i = 0; i < board->count; i++) {
+    uint8_t *entry = &bytes[kScoresHeaderBytes + i * kScoreEntryBytes];
+    putLittleEndian(entry, board->entry[i].score, 4);
+    putLittleEndian(entry + 4, board->entry[i].time, 8);
+  }
+  putLittleEndian(&bytes[body], hashBytes(bytes, body), 4);
+  char temp[kScoresPathSize + 32];
+  snprintf(temp, sizeof(temp), "%s.tmp.%ld", path, (long)getpid());
+  int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool ok = fd >= 0;
+  if (ok) {
+    ok = write(fd, bytes, body + 4) == body + 4;
+    ok = fsync(fd) == 0 && ok;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(temp, path) == 0;
+    if (!ok) {
+      unlink(temp);
+    }
+    ok = ok && syncParentDir(path);
+  }
+  return ok;
+}
+
+// Merges entries into the file under a lock shared with other processes
+bool submitScores(const char *path, const ScoreEntry_t *entries, int count) {
+  char lock_path[kScoresPathSize + 8];
+  snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+  int fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+  struct flock lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+  bool ok = fd >= 0 && fcntl(fd, F_SETLKW, &lock) == 0;
+  if (ok) {
+    Leaderboard_t board;
+    readLeaderboard(path, &board);
+    bool changed = false;
+    for (int i = 0; i < count; i++) {
+      changed = insertScore(&board, entries[i]) || changed;
+    }
+    ok = !changed || writeLeaderboard(path, &board);
+  }
+  if (fd >= 0) {
+    close(fd);  // drops the lock
+  }
+  return ok;
+}
+
+static void *scoresWriterMain(void *arg) {
+  ScoresWriter_t *writer = arg;
+  pthread_mutex_lock(&writer->lock);
+  while (writer->count > 0 || !writer->stop) {
+    if (writer->count == 0) {
+      pthread_cond_wait(&writer->wake, &writer->lock);
+    } else {
+      ScoreEntry_t batch[kScoresQueueSize];
+      int count = writer->count;
+      memcpy(batch, writer->queue, count * sizeof(ScoreEntry_t));
+      writer->count = 0;
+      pthread_mutex_unlock(&writer->lock);
+      submitScores(writer->path, batch, count);
+      pthread_mutex_lock(&writer->lock);
+    }
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return NULL;
+}
+
+// Queues a finished game and returns at once, the first call starts the
+// writer thread. False if the queue is full or the thread cannot start
+bool postScore(ScoreEntry_t entry) {
+  ScoresWriter_t *writer = getScoresWriter();
+  pthread_mutex_lock(&writer->lock);
+  if (!writer->running) {
+    snprintf(writer->path, kScoresPathSize, "%s", getScoresPath());
+    writer->running =
+        pthread_create(&writer->thread, NULL, scoresWriterMain, writer) == 0;
+  }
+  bool posted = writer->running && writer->count < kScoresQueueSize;
+  if (posted) {
+    writer->queue[writer->count++] = entry;
+    pthread_cond_signal(&writer->wake);
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return posted;
+}
+
+// Waits until the queued games are on disk and stops the writer
+void flushScores(void) {
+  ScoresWriter_t *writer = getScoresWriter();
+  pthread_mutex_lock(&writer->lock);
+  bool running = writer->running;
+  writer->stop = true;
+  pthread_cond_signal(&writer->wake);
+  pthread_mutex_unlock(&writer->lock);
+  if (running) {
+    pthread_join(writer->thread, NULL);
+  }
+  pthread_mutex_lock(&writer->lock);
+  writer->running = false;
+  writer->stop = false;
+  pthread_mutex_unlock(&writer->lock);
+}
@@ -0,0 +1,48 @@
+#ifndef BRICK_GAME_TETRIS_HIGHSCORE_H_
+#define BRICK_GAME_TETRIS_HIGHSCORE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Leaderboard file, integers are little endian:
+ *   "BGS" kScoresVersion count                 5 bytes
+ *   score (u32) time (u64)                     count entries, best first
+ *   FNV-1a hash (u32) of everything before it
+ * Writers hold an fcntl() lock on path.lock and replace the file with
+ * rename(), so readers never see a half written board and need no lock.
+ */
+typedef enum {
+  kScoresVersion = 1,
+  kLeaderboardSize = 10,
+  kScoreEntryBytes = 12,
+  kScoresHeaderBytes = 5,
+  kScoresFileBytes =
+      kScoresHeaderBytes + kLeaderboardSize * kScoreEntryBytes + 4,
+  kScoresQueueSize = 16,  // games waiting for the writer thread
+  kScoresPathSize = 4096
+} ScoresLayout_t;
+
+typedef struct {
+  uint32_t score;
+  uint64_t time;  // seconds since the epoch
+} ScoreEntry_t;
+
+typedef struct {
+  int count;
+  ScoreEntry_t entry[kLeaderboardSize];  // best first, older first on ties
+} Leaderboard_t;
+
+const char *getScoresPath(void);
+void setScoresPath(const char *path);
+
+bool insertScore(Leaderboard_t *board, ScoreEntry_t entry);
+bool readLeaderboard(const char *path, Leaderboard_t *board);
+bool writeLeaderboard(const char *path, const Leaderboard_t *board);
+bool submitScores(const char *path, const ScoreEntry_t *entries, int count);
+
+bool postScore(ScoreEntry_t entry);
+void flushScores(void);
+
+#endif  // BRICK_GAME_TETRIS_HIGHSCORE_H_
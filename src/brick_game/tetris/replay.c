@@ -0,0 +1,137 @@
+#include "replay.h"
+
+static const char kMagic[] = "BGR";
+
+void writeVarint(FILE *file, uint64_t value) {
+  while (value >= 0x80) {
+    putc((int)(value & 0x7F) | 0x80, file);
+    value >>= 7;
+  }
+  putc((int)value, file);
+}
+
+bool readVarint(FILE *file, uint64_t *value) {
+  uint64_t result = 0;
+  bool done = false;
+  bool ok = true;
+  for (int shift = 0; !done && ok; shift += 7) {
+    int byte = getc(file);
+    if (byte == EOF || shift > 63) {
+      ok = false;
+    } else {
+      result |= (uint64_t)(byte & 0x7F) << shift;
+      done = (byte & 0x80) == 0;
+    }
+  }
+  *value = result;
+  return ok;
+}
+
+static void writeEvent(Recorder_t *recorder, unsigned long now, int code) {
+  writeVarint(recorder->file,
+              ((uint64_t)(now - recorder->last_ms) << kEventBits) | code);
+  recorder->last_ms = now;
+  recorder->events++;
+}
+
+// Recording starts on a fresh game, the seed makes the figures reproducible
+bool startRecording(Recorder_t *recorder, TetrisInfo_t *game, FILE *file,
+                    uint64_t seed) {
+  bool started = file != NULL && game->state == kStart;
+  if (started) {
+    seedTetrisGame(game, seed);
+    recorder->file = file;
+    recorder->last_ms = gameTimeMs(game);
+    recorder->events = 0;
+    fputs(kMagic, file);
+    writeVarint(file, kReplayVersion);
+    writeVarint(file, seed);
+    writeVarint(file, game->generator.randomizer);
+    writeVarint(file, recorder->last_ms);
+    writeVarint(file, game->last_tick);
+    writeVarint(file, game->update_interval);
+    game->recorder = recorder;
+  }
+  return started;
+}
+
+void recordInput(Recorder_t *recorder, unsigned long now, UserAction_t action,
+                 bool hold) {
+  writeEvent(recorder, now, (hold << 3) | action);
+}
+
+void recordTick(Recorder_t *recorder, unsigned long now) {
+  writeEvent(recorder, now, kEventTick);
+}
+
+// Closes the log with the final score and field for replayLog() to check
+bool stopRecording(Recorder_t *recorder, TetrisInfo_t *game) {
+  writeEvent(recorder, gameTimeMs(game), kEventEnd);
+  writeVarint(recorder->file, (uint64_t)game->score);
+  // Rows as shown on screen, like the logs of the stamping engine
+  Row_t rows[kRows];
+  composeField(game, rows);
+  for (int i = 0; i < kRows; i++) {
+    writeVarint(recorder->file, rows[i]);
+  }
+  game->recorder = NULL;
+  return fflush(recorder->file) == 0 && !ferror(recorder->file);
+}
+
+static bool readHeader(FILE *file, TetrisInfo_t *game) {
+  bool ok = true;
+  for (int i = 0; kMagic[i] && ok; i++) {
+    ok = getc(file) == kMagic[i];
+  }
+  uint64_t header[6] = {0};
+  for (int i = 0; i < 6 && ok; i++) {
+    ok = readVarint(file, &header[i]);
+  }
+  if (ok && header[0] == kReplayVersion) {
+    seedTetrisGame(game, header[1]);
+    setRandomizer(game, (Randomizer_t)header[2]);
+    setVirtualClock(game, header[3]);
+    game->last_tick = header[4];
+    game->update_interval = header[5];
+  } else {
+    ok = false;
+  }
+  return ok;
+}
+
+// Runs a log on a private game with a virtual clock, nothing is allocated
+bool replayLog(FILE *file, ReplayResult_t *result) {
+  TetrisInfo_t game;
+  initTetrisInfo(&game);
+  memset(result, 0, sizeof(*result));
+  bool ok = readHeader(file, &game);
+  bool end = false;
+  while (ok && !end) {
+    uint64_t event = 0;
+    ok = readVarint(file, &event);
+    int code = (int)(event & ((1u << kEventBits) - 1));
+    advanceClock(&game, event >> kEventBits);
+    if (ok && code == kEventEnd) {
+      end = true;
+    } else if (ok && code == kEventTick) {
+      applyGravity(&game);
+      result->ticks++;
+    } else if (ok) {
+      tetrisUserInput(&game, (UserAction_t)(code & 7), code >> 3);
+    }
+    result->events += ok;
+  }
+  uint64_t value = 0;
+  ok = ok && readVarint(file, &value);
+  result->score = game.score;
+  result->expected_score = (int)value;
+  result->score_matches = ok && result->score == result->expected_score;
+  result->field_matches = ok;
+  Row_t rows[kRows];
+  composeField(&game, rows);
+  for (int i = 0; i < kRows && ok; i++) {
+    ok = readVarint(file, &value);
+    result->field_matches = result->field_matches && ok && value == rows[i];
+  }
+  return ok && result->score_matches && result->field_matches;
+}
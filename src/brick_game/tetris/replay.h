@@ -0,0 +1,47 @@
+#ifndef BRICK_GAME_TETRIS_REPLAY_H_
+#define BRICK_GAME_TETRIS_REPLAY_H_
+
+#include "tetris.h"
+
+/**
+ * Log layout, every number is an unsigned LEB128 varint:
+ *   header  "BGR" kReplayVersion seed randomizer start_ms last_tick interval
+ *   event   (delta_ms << kEventBits) | code    delta from the previous event
+ *   footer  score row[0] ... row[kRows - 1]    after the kEventEnd event
+ * Codes below kEventTick are (hold << 3) | action of tetrisUserInput().
+ */
+typedef enum {
+  kReplayVersion = 1,
+  kEventBits = 5,
+  kEventTick = 16,  // gravity step of applyGravity()
+  kEventEnd = 17
+} ReplayFormat_t;
+
+struct Recorder {
+  FILE *file;
+  unsigned long last_ms;
+  unsigned long events;
+};
+
+typedef struct {
+  unsigned long events;
+  unsigned long ticks;
+  int score;
+  int expected_score;
+  bool score_matches;
+  bool field_matches;
+} ReplayResult_t;
+
+void writeVarint(FILE *file, uint64_t value);
+bool readVarint(FILE *file, uint64_t *value);
+
+bool startRecording(Recorder_t *recorder, TetrisInfo_t *game, FILE *file,
+                    uint64_t seed);
+void recordInput(Recorder_t *recorder, unsigned long now, UserAction_t action,
+                 bool hold);
+void recordTick(Recorder_t *recorder, unsigned long now);
+bool stopRecording(Recorder_t *recorder, TetrisInfo_t *game);
+
+bool replayLog(FILE *file, ReplayResult_t *result);
+
+#endif  // BRICK_GAME_TETRIS_REPLAY_H_
@@ -0,0 +1,114 @@
+#include "snapshot.h"
+
+typedef enum {
+  kTypeBits = 3,
+  kBagShift = kQueueSize * kTypeBits,
+  kBagLeftShift = kBagShift + kTetrominoes * kTypeBits,
+  kHeadShift = kBagLeftShift + kTypeBits
+} DeckLayout_t;
+
+_Static_assert(kQueueSize <= 8, "the queue head is packed in 3 bits");
+
+static uint64_t packTypes(const Tetromino_t *types, int count) {
+  uint64_t bits = 0;
+  for (int i = 0; i < count; i++) {
+    bits |= (uint64_t)types[i] << (i * kTypeBits);
+  }
+  return bits;
+}
+
+// False when a type is out of range
+static bool unpackTypes(uint64_t bits, Tetromino_t *types, int count) {
+  bool ok = true;
+  for (int i = 0; i < count; i++) {
+    int type = (int)((bits >> (i * kTypeBits)) & 7u);
+    ok = ok && type < kTetrominoes;
+    types[i] = (Tetromino_t)(type < kTetrominoes ? type : 0);
+  }
+  return ok;
+}
+
+Snapshot_t snapshotGame(const TetrisInfo_t *game) {
+  Snapshot_t snapshot;
+  // Zeroed padding keeps equal games bytewise equal
+  memset(&snapshot, 0, sizeof(snapshot));
+  snapshot.deck =
+      packTypes(game->generator.queue, kQueueSize) |
+      packTypes(game->generator.bag, kTetrominoes) << kBagShift |
+      (uint64_t)game->generator.bag_left << kBagLeftShift |
+      (uint64_t)game->generator.head << kHeadShift;
+  memcpy(snapshot.rng, game->generator.rng.s, sizeof(snapshot.rng));
+  snapshot.score = (uint32_t)game->score;
+  snapshot.high_score = (uint32_t)game->high_score;
+  snapshot.pieces = (uint32_t)game->pieces;
+  snapshot.since_tick = (uint32_t)(gameTimeMs(game) - game->last_tick);
+  memcpy(snapshot.row, game->field.row, sizeof(snapshot.row));
+  snapshot.update_interval = (uint16_t)game->update_interval;
+  snapshot.figure =
+      (uint8_t)(game->current.fig.type | game->current.fig.rotation << 3);
+  snapshot.x = (int8_t)game->current.coordinate.x;
+  snapshot.y = (int8_t)game->current.coordinate.y;
+  snapshot.level = (uint8_t)game->level;
+  snapshot.speed = (uint8_t)game->speed;
+  snapshot.flags =
+      (uint8_t)(game->state | (game->pause != 0) << 2 |
+                game->next_empty << 3 | game->generator.randomizer << 4 |
+                game->score_saved << 5);
+  return snapshot;
+}
+
+// Checks the whole snapshot before the game is touched
+bool restoreGame(TetrisInfo_t *game, const Snapshot_t *snapshot) {
+  Tetromino_t queue[kQueueSize];
+  Tetromino_t bag[kTetrominoes];
+  int type = snapshot->figure & 7;
+  int bag_left = (int)((snapshot->deck >> kBagLeftShift) & 7u);
+  bool ok = unpackTypes(snapshot->deck, queue, kQueueSize) &&
+            unpackTypes(snapshot->deck >> kBagShift, bag, kTetrominoes) &&
+            type < kTetrominoes && bag_left <= kTetrominoes &&
+            snapshot->update_interval > 0;
+#ifndef NO_LIMITS
+  ok = ok && snapshot->level <= kMaxLevel && snapshot->speed <= kMaxLevel;
+#endif  // NO_LIMITS
+  for (int i = 0; ok && i < kRows; i++) {
+    ok = (snapshot->row[i] & (Row_t)~FULL_ROW) == 0;
+  }
+  // A lost game keeps the figure that did not fit, any other must fit
+  if (ok && (snapshot->flags & 3) != kGameOver) {
+    int rotation = snapshot->figure >> 3 & 3;
+    const Orientation_t *shape = &kOrientations[type][rotation];
+    ok = figureFits(snapshot->row, shape, snapshot->x, snapshot->y);
+  }
+  if (ok) {
+    memcpy(game->generator.queue, queue, sizeof(queue));
+    memcpy(game->generator.bag, bag, sizeof(bag));
+    game->generator.bag_left = bag_left;
+    game->generator.head = (int)((snapshot->deck >> kHeadShift) & 7u);
+    memcpy(game->generator.rng.s, snapshot->rng, sizeof(snapshot->rng));
+    game->generator.randomizer = (Randomizer_t)(snapshot->flags >> 4 & 1);
+    game->score = (int)snapshot->score;
+    game->high_score = (int)snapshot->high_score;
+    game->pieces = snapshot->pieces;
+    game->update_interval = snapshot->update_interval;
+    game->last_tick = gameTimeMs(game) - snapshot->since_tick;
+    memcpy(game->field.row, snapshot->row, sizeof(snapshot->row));
+    syncFieldMeta(&game->field);
+    game->current.fig.type = (Tetromino_t)type;
+    game->current.fig.rotation = snapshot->figure >> 3 & 3;
+    game->current.coordinate.x = snapshot->x;
+    game->current.coordinate.y = snapshot->y;
+    game->current.offset_x = 0;
+    game->current.offset_y = 0;
+    setFigure(&game->next.fig, queue[game->generator.head]);
+    game->level = snapshot->level;
+    game->speed = snapshot->speed;
+    game->state = (TetrisState_t)(snapshot->flags & 3);
+    game->pause = snapshot->flags >> 2 & 1;
+    game->next_empty = snapshot->flags >> 3 & 1;
+    game->score_saved = snapshot->flags >> 5 & 1;
+    game->run_game = true;
+    memset(&game->last_cleared, 0, sizeof(game->last_cleared));
+    markChanged(game);
+  }
+  return ok;
+}
@@ -0,0 +1,38 @@
+#ifndef BRICK_GAME_TETRIS_SNAPSHOT_H_
+#define BRICK_GAME_TETRIS_SNAPSHOT_H_
+
+#include "tetris.h"
+
+/**
+ * Everything a game needs to go on, as one plain struct that is copied
+ * with memcpy(). Column heights and fill counts are rebuilt on restore,
+ * the clock, the recorder and the frame of the game are left as they are.
+ *   deck   bits 0-23 queue, 24-44 bag, 45-47 bag_left, 48-50 head
+ *   figure type | rotation << 3
+ *   flags  state | pause << 2 | next_empty << 3 | randomizer << 4 |
+ *          score_saved << 5
+ */
+typedef struct {
+  uint64_t deck;
+  uint32_t rng[4];
+  uint32_t score;
+  uint32_t high_score;
+  uint32_t pieces;
+  uint32_t since_tick;  // ms from the last gravity step to the snapshot
+  Row_t row[kRows];
+  uint16_t update_interval;
+  uint8_t figure;
+  int8_t x;
+  int8_t y;
+  uint8_t level;
+  uint8_t speed;
+  uint8_t flags;
+} Snapshot_t;
+
+_Static_assert(sizeof(Snapshot_t) <= 56 + kRows * sizeof(Row_t),
+              "snapshots stay small, 96 bytes on the 10x20 board");
+
+Snapshot_t snapshotGame(const TetrisInfo_t *game);
+bool restoreGame(TetrisInfo_t *game, const Snapshot_t *snapshot);
+
+#endif  // BRICK_GAME_TETRIS_SNAPSHOT_H_
@@ -0,0 +1,205 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "spectate.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Shared memory object of a broadcast, false when name does not fit
+static bool sharedName(const char *name, char *path) {
+  bool ok = name[0] != '\0' && strchr(name, '/') == NULL;
+  ok = ok && snprintf(path, kSpectateNameSize, "/brick_game.%s", name) <
+                 kSpectateNameSize;
+  return ok;
+}
+
+// The first frame goes out as a keyframe right away
+bool startBroadcast(Broadcaster_t *broadcaster, TetrisInfo_t *game,
+                    const char *name) {
+  bool named = sharedName(name, broadcaster->name);
+  int fd = -1;
+  if (named) {
+    // Spectators of an older game keep their mapping of it
+    shm_unlink(broadcaster->name);
+    fd = shm_open(broadcaster->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  bool ok = fd >= 0 && ftruncate(fd, sizeof(SpectateRing_t)) == 0;
+  void *memory = ok ? mmap(NULL, sizeof(SpectateRing_t),
+                           PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                    : MAP_FAILED;
+  ok = memory != MAP_FAILED;
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (ok) {
+    // ftruncate() has zeroed the ring
+    broadcaster->ring = memory;
+    broadcaster->records = 0;
+    memset(broadcaster->field, 0, sizeof(broadcaster->field));
+    broadcaster->ring->version = kSpectateVersion;
+    broadcaster->ring->geometry = kSpectateGeometry;
+    atomic_store_explicit(&broadcaster->ring->magic, kSpectateMagic,
+                          memory_order_release);
+    broadcastFrame(broadcaster, getTetrisFrame(game));
+    game->broadcaster = broadcaster;
+  } else if (fd >= 0) {
+    shm_unlink(broadcaster->name);
+  }
+  return ok;
+}
+
+// Never waits, a spectator that is still reading the slot notices it
+void broadcastFrame(Broadcaster_t *broadcaster, const Frame_t *frame) {
+  SpectateRing_t *ring = broadcaster->ring;
+  unsigned long number = broadcaster->records++;
+  SpectateRecord_t *record = &ring->record[number % kSpectateSlots];
+  bool keyframe = number % kKeyframeInterval == 0;
+  atomic_store_explicit(&record->sequence, 2 * number + 1,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  uint64_t changed = 0;
+  int count = 0;
+  for (int i = 0; i < FRAME_ROWS; i++) {
+    if (keyframe || frame->field[i] != broadcaster->field[i]) {
+      changed |= (uint64_t)1 << i;
+      record->row[count++] = frame->field[i];
+      broadcaster->field[i] = frame->field[i];
+    }
+  }
+  record->version = frame->version;
+  record->changed = changed;
+  record->keyframe = keyframe;
+  record->level = (uint8_t)frame->level;
+  record->speed = (uint8_t)frame->speed;
+  record->flags = (uint8_t)((frame->pause != 0) | frame->running << 1);
+  record->score = frame->score;
+  record->high_score = frame->high_score;
+  memcpy(record->next, frame->next, sizeof(record->next));
+  atomic_store_explicit(&record->sequence, 2 * number + 2,
+                        memory_order_release);
+  if (keyframe) {
+    atomic_store_explicit(&ring->keyframe, number, memory_order_release);
+  }
+  atomic_store_explicit(&ring->head, number + 1, memory_order_release);
+}
+
+void stopBroadcast(Broadcaster_t *broadcaster, TetrisInfo_t *game) {
+  if (game->broadcaster == broadcaster) {
+    game->broadcaster = NULL;
+  }
+  munmap(broadcaster->ring, sizeof(SpectateRing_t));
+  shm_unlink(broadcaster->name);
+  broadcaster->ring = NULL;
+}
+
+bool attachSpectator(Spectator_t *spectator, const char *name) {
+  char path[kSpectateNameSize];
+  memset(spectator, 0, sizeof(*spectator));
+  int fd = sharedName(name, path) ? shm_open(path, O_RDONLY, 0) : -1;
+  struct stat info;
+  bool ok = fd >= 0 && fstat(fd, &info) == 0 &&
+            info.st_size == (off_t)sizeof(SpectateRing_t);
+  void *memory = ok ? mmap(NULL, sizeof(SpectateRing_t), PROT_READ,
+                           MAP_SHARED, fd, 0)
+                    : MAP_FAILED;
+  if (fd >= 0) {
+    close(fd);
+  }
+  ok = memory != MAP_FAILED;
+  if (ok) {
+    const SpectateRing_t *ring = memory;
+    ok = atomic_load_explicit(&ring->magic, memory_order_acquire) ==
+             kSpectateMagic &&
+         ring->version == kSpectateVersion &&
+         ring->geometry == kSpectateGeometry;
+    if (ok) {
+      spectator->ring = ring;
+    } else {
+      munmap(memory, sizeof(SpectateRing_t));
+    }
+  }
+  return ok;
+}
+
+// False when the game has written the slot again meanwhile
+static bool readRecord(const SpectateRing_t *ring, unsigned long number,
+                       SpectateRecord_t *record) {
+  const SpectateRecord_t *slot = &ring->record[number % kSpectateSlots];
+  unsigned long expected = 2 * number + 2;
+  bool ok = atomic_load_explicit(&slot->sequence, memory_order_acquire) ==
+            expected;
+  if (ok) {
+    size_t start = offsetof(SpectateRecord_t, version);
+    memcpy((char *)record + start, (const char *)slot + start,
+           sizeof(*record) - start);
+    atomic_thread_fence(memory_order_acquire);
+    ok = atomic_load_explicit(&slot->sequence, memory_order_relaxed) ==
+         expected;
+  }
+  return ok;
+}
+
+static void applyRecord(Frame_t *frame, const SpectateRecord_t *record) {
+  int count = 0;
+  for (int i = 0; i < FRAME_ROWS; i++) {
+    if (record->changed >> i & 1) {
+      frame->field[i] = record->row[count++];
+    }
+  }
+  memcpy(frame->next, record->next, sizeof(frame->next));
+  frame->version = (unsigned long)record->version;
+  frame->score = record->score;
+  frame->high_score = record->high_score;
+  frame->level = record->level;
+  frame->speed = record->speed;
+  frame->pause = record->flags & 1;
+  frame->running = record->flags >> 1 & 1;
+}
+
+// Applies every record written since the last call
+SpectateStatus_t pollSpectator(Spectator_t *spectator) {
+  const SpectateRing_t *ring = spectator->ring;
+  // The keyframe is loaded first, so it is never past head
+  unsigned long keyframe =
+      atomic_load_explicit(&ring->keyframe, memory_order_acquire);
+  unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (spectator->synced && head - spectator->next > kSpectateSlots) {
+    spectator->synced = false;
+    spectator->resyncs++;
+  }
+  if (!spectator->synced) {
+    spectator->next = keyframe;
+  }
+  bool changed = false;
+  bool torn = false;
+  while (!torn && spectator->next < head) {
+    SpectateRecord_t record;
+    torn = !readRecord(ring, spectator->next, &record);
+    if (torn) {
+      spectator->synced = false;
+      spectator->resyncs++;
+    } else {
+      // A late spectator starts at a keyframe, so the first one syncs
+      if (record.keyframe || spectator->synced) {
+        applyRecord(&spectator->frame, &record);
+        spectator->synced = true;
+        changed = true;
+      }
+      spectator->next++;
+    }
+  }
+  SpectateStatus_t status = kSpectateLost;
+  if (changed) {
+    status = kSpectateFrame;
+  } else if (spectator->synced) {
+    status = kSpectateIdle;
+  }
+  return status;
+}
+
+void detachSpectator(Spectator_t *spectator) {
+  munmap((void *)spectator->ring, sizeof(SpectateRing_t));
+  spectator->ring = NULL;
+}
@@ -0,0 +1,85 @@
+#ifndef BRICK_GAME_TETRIS_SPECTATE_H_
+#define BRICK_GAME_TETRIS_SPECTATE_H_
+
+#include "tetris.h"
+
+/**
+ * Frames of one game for any number of local spectators. The game writes
+ * every record once into a POSIX shared memory ring, spectators map it
+ * read only and follow at their own pace, the game never waits for them.
+ * A record holds the stats of a frame and the field rows that changed
+ * since the previous record, every kKeyframeInterval-th record holds all
+ * rows. A spectator that attaches late or falls more than kSpectateSlots
+ * records behind starts over from the latest keyframe.
+ */
+typedef enum {
+  kSpectateMagic = 0x42475352,  // "RSGB"
+  kSpectateVersion = 1,
+  kSpectateSlots = 256,
+  kKeyframeInterval = 64,  // below kSpectateSlots, a keyframe is always kept
+  kSpectateNameSize = 64,
+  kSpectatePollMs = 15,  // how often brick_watch looks for new records
+  kSpectateGeometry = BOARD_COLS << 8 | BOARD_ROWS
+} SpectateLayout_t;
+
+_Static_assert(kKeyframeInterval < kSpectateSlots,
+               "the ring holds a keyframe at any time");
+_Static_assert(FRAME_ROWS <= 64, "a record marks changed rows in 64 bits");
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2,
+               "atomics in shared memory must not hide a lock");
+
+typedef struct {
+  atomic_ulong sequence;  // 2 * record + 1 while written, 2 * record + 2 after
+  uint64_t version;
+  uint64_t changed;  // bit i is set when field row i is in row[]
+  uint8_t keyframe;
+  uint8_t level;
+  uint8_t speed;
+  uint8_t flags;  // pause | running << 1
+  int32_t score;
+  int32_t high_score;
+  uint32_t next[FRAME_NEXT];
+  BoardRow_t row[FRAME_ROWS];  // the changed rows, top first
+} SpectateRecord_t;
+
+typedef struct {
+  atomic_uint magic;  // set last, the ring is ready once it matches
+  uint32_t version;
+  uint32_t geometry;  // BOARD_COLS << 8 | BOARD_ROWS of the game
+  atomic_ulong head;      // records written so far
+  atomic_ulong keyframe;  // number of the latest keyframe record
+  SpectateRecord_t record[kSpectateSlots];
+} SpectateRing_t;
+
+struct Broadcaster {
+  SpectateRing_t *ring;
+  char name[kSpectateNameSize];
+  unsigned long records;
+  BoardRow_t field[FRAME_ROWS];  // rows of the previous record
+};
+
+typedef enum {
+  kSpectateIdle,   // nothing new
+  kSpectateFrame,  // frame changed
+  kSpectateLost    // fell behind, waiting for a keyframe
+} SpectateStatus_t;
+
+/** Read side, frame is valid once synced */
+typedef struct {
+  const SpectateRing_t *ring;
+  unsigned long next;  // record to read next
+  bool synced;         // frame holds a keyframe and every record after it
+  unsigned long resyncs;
+  Frame_t frame;
+} Spectator_t;
+
+bool startBroadcast(Broadcaster_t *broadcaster, TetrisInfo_t *game,
+                    const char *name);
+void broadcastFrame(Broadcaster_t *broadcaster, const Frame_t *frame);
+void stopBroadcast(Broadcaster_t *broadcaster, TetrisInfo_t *game);
+
+bool attachSpectator(Spectator_t *spectator, const char *name);
+SpectateStatus_t pollSpectator(Spectator_t *spectator);
+void detachSpectator(Spectator_t *spectator);
+
+#endif  // BRICK_GAME_TETRIS_SPECTATE_H_
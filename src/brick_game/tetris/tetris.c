@@ -1,113 +1,211 @@
 #include "tetris.h"
 
-TetrisState_t *initState() {
-  static TetrisState_t state = kStart;
-  return &state;
-}
+#include "../profile/profile.h"
+#include "highscore.h"
+#include "replay.h"
+#include "spectate.h"
 
-TetrisState_t *getState() {
-  static TetrisState_t *ptr_state = NULL;
-  if (ptr_state == NULL) {
-    ptr_state = initState();
-  }
-  return ptr_state;
-}
+TetrisState_t *getState() { return &getTetrisInfo()->state; }
 
-void setState(TetrisState_t new_state) {
-  TetrisState_t *ptr_state = getState();
-  *ptr_state = new_state;
+void setState(TetrisInfo_t *game, TetrisState_t new_state) {
+  game->state = new_state;
+  markChanged(game);
 }
 
-TetrisInfo_t *getTetrisInfo() {
-  static TetrisInfo_t *game = NULL;
-  if (game == NULL) {
-    game = initTetrisInfo();
-  }
-  return game;
-}
+// Anything shown through GameInfo_t changed, see getStateVersion()
+void markChanged(TetrisInfo_t *game) { game->version++; }
 
-TetrisInfo_t *initTetrisInfo() {
-  srand(time(NULL));
-  static TetrisInfo_t game = {.run_game = true, .update_interval = 1000};
-  for (int i = 0; i < kFigRows; i++) {
-    game.next.fig.row[i] = game.next.fig.cell[i];
-    game.current.fig.row[i] = game.current.fig.cell[i];
-  }
+unsigned long getStateVersion() { return getTetrisInfo()->version; }
+
+uint64_t getBoardHash() { return getTetrisInfo()->field.hash; }
+
+long getUpdateDelayMs() { return nextShiftDelayMs(getTetrisInfo()); }
+
+// Default instance behind userInput() and updateCurrentState()
+TetrisInfo_t *getTetrisInfo() {
+  static TetrisInfo_t game;
+  static TetrisInfo_t *ptr_game = NULL;
+  if (ptr_game == NULL) {
+    initTetrisInfo(&game);
+    seedTetrisGame(&game, (uint64_t)time(NULL));
+    game.persistent = true;
+    loadHighScore(&game);
+    ptr_game = &game;
+  }
+  return ptr_game;
+}
+
+void initTetrisInfo(TetrisInfo_t *game) {
+  memset(game, 0, sizeof(*game));
+  syncFieldMeta(&game->field);
+  game->state = kStart;
+  game->run_game = true;
+  game->next_empty = true;
+  game->update_interval = 1000;
+  setRealClock(game);
+  seedTetrisGame(game, 0);
   for (int i = 0; i < kRows; i++) {
-    game.field.row[i] = game.field.cell[i];
+    game->view.field[i] = game->view.field_cells[i];
   }
-  FILE *file = fopen("highscore_tetris.txt", "r");
-  if (file) {
-    fscanf(file, "%d", &game.high_score);
-    fclose(file);
+  for (int i = 0; i < kFigRows; i++) {
+    game->view.next[i] = game->view.next_cells[i];
   }
-  return &game;
+  game->view.info.field = game->view.field;
+  game->view.info.next = game->view.next;
 }
 
-GameInfo_t *getGameInfo() {
-  TetrisInfo_t *game = getTetrisInfo();
-  static GameInfo_t game_info;
-  static GameInfo_t *ptr_game_info = NULL;
-  if (ptr_game_info == NULL) {
-    game_info.field = (int **)game->field.row;
-    game_info.next = (int **)game->next.fig.row;
-
-    ptr_game_info = &game_info;
+TetrisInfo_t *createTetrisGame() {
+  TetrisInfo_t *game = malloc(sizeof(TetrisInfo_t));
+  if (game) {
+    initTetrisInfo(game);
+    // Unseeded games differ from each other, seedTetrisGame() to reproduce
+    seedTetrisGame(game, (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)game);
   }
-  if (game->run_game) {
-    game_info.speed = game->speed;
-    game_info.score = game->score;
-    game_info.high_score = game->high_score;
-    game_info.level = game->level;
-    game_info.pause = game->pause;
-  } else {
+  return game;
+}
+
+void destroyTetrisGame(TetrisInfo_t *game) { free(game); }
+
+GameInfo_t *getGameInfo(TetrisInfo_t *game) {
+  GameInfo_t *game_info = &game->view.info;
+  if (game->run_game && game->view.version != game->version) {
+    // int** view of the bitboard for the frontend, rebuilt after changes
+    game->view.version = game->version;
+    Row_t rows[kRows];
+    composeField(game, rows);
+    expandRows(game->view.field, rows, kRows, kCols);
+    expandRows(game->view.next, figureShape(&game->next.fig)->row, kFigRows,
+               kFigCols);
+    game_info->speed = game->speed;
+    game_info->score = game->score;
+    game_info->high_score = game->high_score;
+    game_info->level = game->level;
+    game_info->pause = game->pause;
+  } else if (!game->run_game) {
     // Установка NULL спользуется для передачи на интерфейс информации о том,
     // что пользователь хочет выйти из программы BrickGame
-    game_info.field = NULL;
-    game_info.next = NULL;
+    game_info->field = NULL;
+    game_info->next = NULL;
+  }
+  return game_info;
+}
+
+const Frame_t *tetrisUpdateFrame(TetrisInfo_t *game) {
+  PROFILE_START(update);
+  applyGravity(game);
+  const Frame_t *frame = getTetrisFrame(game);
+  PROFILE_STOP(update, kProfileUpdateCurrentState);
+  return frame;
+}
+
+// Latest frame, published again only after the game has changed
+const Frame_t *getTetrisFrame(TetrisInfo_t *game) {
+  FrameBuffer_t *frames = &game->frames;
+  unsigned long published =
+      atomic_load_explicit(&frames->published, memory_order_relaxed);
+  const Frame_t *latest = &frames->frame[published & 1];
+  if (published == 0 || latest->version != game->version) {
+    publishFrame(game);
+  }
+  published = atomic_load_explicit(&frames->published, memory_order_relaxed);
+  return &frames->frame[published & 1];
+}
+
+// Fills the older frame, readers of the latest one are not disturbed
+void publishFrame(TetrisInfo_t *game) {
+  FrameBuffer_t *frames = &game->frames;
+  unsigned long published =
+      atomic_load_explicit(&frames->published, memory_order_relaxed) + 1;
+  int slot = (int)(published & 1);
+  unsigned long sequence =
+      atomic_load_explicit(&frames->sequence[slot], memory_order_relaxed);
+  atomic_store_explicit(&frames->sequence[slot], sequence + 1,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  Frame_t *frame = &frames->frame[slot];
+  Row_t rows[kRows];
+  composeField(game, rows);
+  for (int i = 0; i < kRows; i++) {
+    frame->field[i] = rows[i];
   }
-  return ptr_game_info;
-}
-
-void clearTetrisInfo() {
-  TetrisInfo_t *game = getTetrisInfo();
-  game->last_tick = currentTimeMs();
+  const Orientation_t *next = figureShape(&game->next.fig);
+  for (int i = 0; i < kFigRows; i++) {
+    frame->next[i] = next->row[i];
+  }
+  frame->version = game->version;
+  frame->score = game->score;
+  frame->high_score = game->high_score;
+  frame->level = game->level;
+  frame->speed = game->speed;
+  frame->pause = game->pause;
+  frame->running = game->run_game;
+  atomic_store_explicit(&frames->sequence[slot], sequence + 2,
+                        memory_order_release);
+  atomic_store_explicit(&frames->published, published, memory_order_release);
+  if (game->broadcaster) {
+    broadcastFrame(game->broadcaster, frame);
+  }
+}
+
+// The frame may be read in place until endFrameRead() with the same ticket
+const Frame_t *beginFrameRead(const FrameBuffer_t *frames,
+                              FrameTicket_t *ticket) {
+  unsigned long published =
+      atomic_load_explicit(&frames->published, memory_order_acquire);
+  ticket->slot = (int)(published & 1);
+  ticket->sequence = atomic_load_explicit(&frames->sequence[ticket->slot],
+                                          memory_order_acquire);
+  return &frames->frame[ticket->slot];
+}
+
+// False when the frame changed while it was read, read it again then
+bool endFrameRead(const FrameBuffer_t *frames, FrameTicket_t ticket) {
+  atomic_thread_fence(memory_order_acquire);
+  return (ticket.sequence & 1) == 0 &&
+         atomic_load_explicit(&frames->sequence[ticket.slot],
+                              memory_order_relaxed) == ticket.sequence;
+}
+
+void clearTetrisInfo(TetrisInfo_t *game) {
+  game->last_tick = gameTimeMs(game);
   game->level = 0;
   game->speed = 0;
   game->score = 0;
-  clearArray(game->current.fig.row, kFigRows, kFigCols);
-  clearArray(game->field.row, kRows, kCols);
+  game->pieces = 0;
+  game->score_saved = false;
+  setFigure(&game->current.fig, kFigureI);
+  memset(&game->field, 0, sizeof(game->field));
+  syncFieldMeta(&game->field);
+  markChanged(game);
 }
 
-void clearArray(int **array, int rows, int cols) {
-  // maybe memset 0 ?
-  for (int i = 0; i < rows; i++) {
+void expandRows(int **cells, const Row_t *rows, int count, int cols) {
+  for (int i = 0; i < count; i++) {
     for (int j = 0; j < cols; j++) {
-      array[i][j] = 0;
+      cells[i][j] = (rows[i] >> j) & 1;
     }
   }
 }
 
-void onMovingState(UserAction_t action) {
-  TetrisInfo_t *game = getTetrisInfo();
+void onMovingState(TetrisInfo_t *game, UserAction_t action) {
   switch (action) {
     case Left:
-      tryMoveFigure(action);
+      tryMoveFigure(game, action);
       break;
     case Right:
-      tryMoveFigure(action);
+      tryMoveFigure(game, action);
       break;
     case Down:
-      dropFigure();
+      dropFigure(game);
       break;
     case Action:
-      tryRotateFigure();
+      tryRotateFigure(game);
       break;
     case Terminate:
-      handleTerminateState();
+      handleTerminateState(game);
       break;
     case Pause:
-      setState(kPause);
+      setState(game, kPause);
       game->pause = 1;
       break;
     default:
@@ -116,50 +214,75 @@ void onMovingState(UserAction_t action) {
 }
 
 void userInput(UserAction_t action, bool hold) {
-  TetrisState_t state = *getState();
-  switch (state) {
+  tetrisUserInput(getTetrisInfo(), action, hold);
+}
+
+GameInfo_t updateCurrentState() {
+  return tetrisUpdateCurrentState(getTetrisInfo());
+}
+
+const Frame_t *updateFrame() { return tetrisUpdateFrame(getTetrisInfo()); }
+
+void tetrisUserInput(TetrisInfo_t *game, UserAction_t action, bool hold) {
+  PROFILE_START(input);
+  if (game->recorder) {
+    recordInput(game->recorder, gameTimeMs(game), action, hold);
+  }
+  switch (game->state) {
     case kStart:
-      onStartState(action);
+      onStartState(game, action);
       break;
     case kPause:
-      onPauseState(action);
+      onPauseState(game, action);
       break;
     case kMoving:
-      onMovingState(action);
+      onMovingState(game, action);
       break;
     case kGameOver:
-      onGameOverState(action);
+      onGameOverState(game, action);
       break;
     default:
       break;
   }
+  PROFILE_STOP(input, kProfileUserInput);
 }
 
-GameInfo_t updateCurrentState() {
-  TetrisState_t state = *getState();
-  if (state == kMoving && timeToShift()) {
-    if (!tryMoveFigure(Down)) {
-      handleAttaching();
-      if (checkGameOver()) {
-        saveHighScore();
-        setState(kGameOver);
+GameInfo_t tetrisUpdateCurrentState(TetrisInfo_t *game) {
+  PROFILE_START(update);
+  applyGravity(game);
+  GameInfo_t game_info = *getGameInfo(game);
+  PROFILE_STOP(update, kProfileUpdateCurrentState);
+  return game_info;
+}
+
+// Headless part of tetrisUpdateCurrentState(), true if the figure was shifted
+bool applyGravity(TetrisInfo_t *game) {
+  bool shifted = game->state == kMoving && timeToShift(game);
+  if (shifted) {
+    if (game->recorder) {
+      recordTick(game->recorder, game->last_tick);
+    }
+    if (!tryMoveFigure(game, Down)) {
+      handleAttaching(game);
+      if (checkGameOver(game)) {
+        saveHighScore(game);
+        setState(game, kGameOver);
       } else {
-        generateNextFigure();
+        generateNextFigure(game);
       }
     }
   }
-  return *getGameInfo();
+  return shifted;
 }
 
-void handleTerminateState() {
-  TetrisInfo_t *game = getTetrisInfo();
-  saveHighScore();
+void handleTerminateState(TetrisInfo_t *game) {
+  saveHighScore(game);
   game->run_game = false;
+  markChanged(game);
 }
 
-bool timeToShift() {
-  TetrisInfo_t *game = getTetrisInfo();
-  unsigned long now = currentTimeMs();
+bool timeToShift(TetrisInfo_t *game) {
+  unsigned long now = gameTimeMs(game);
   if (now - game->last_tick >= game->update_interval) {
     game->last_tick = now;
     return true;
@@ -167,18 +290,79 @@ bool timeToShift() {
   return false;
 }
 
+// Time left until timeToShift() fires, -1 while gravity is stopped
+long nextShiftDelayMs(TetrisInfo_t *game) {
+  long delay = -1;
+  if (game->state == kMoving) {
+    unsigned long passed = gameTimeMs(game) - game->last_tick;
+    delay = passed >= game->update_interval
+                ? 0
+                : (long)(game->update_interval - passed);
+  }
+  return delay;
+}
+
 unsigned long currentTimeMs() {
   struct timespec ts;
   clock_gettime(1, &ts);
   return (unsigned long)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
 }
 
-void saveHighScore() {
-  TetrisInfo_t *game = getTetrisInfo();
-  FILE *file = fopen("highscore_tetris.txt", "w");
-  if (file) {
-    fprintf(file, "%d\n", game->high_score);
-    fclose(file);
+unsigned long realClockMs(void *context) {
+  (void)context;
+  return currentTimeMs();
+}
+
+unsigned long virtualClockMs(void *context) {
+  TetrisInfo_t *game = context;
+  return game->clock.virtual_ms;
+}
+
+unsigned long gameTimeMs(const TetrisInfo_t *game) {
+  return game->clock.now(game->clock.context);
+}
+
+void setTimeSource(TetrisInfo_t *game, TimeSource_t source, void *context) {
+  game->clock.now = source;
+  game->clock.context = context;
+}
+
+void setRealClock(TetrisInfo_t *game) {
+  setTimeSource(game, realClockMs, NULL);
+}
+
+// Time stands still until advanceClock() is called
+void setVirtualClock(TetrisInfo_t *game, unsigned long start_ms) {
+  game->clock.virtual_ms = start_ms;
+  game->last_tick = start_ms;
+  setTimeSource(game, virtualClockMs, game);
+}
+
+void advanceClock(TetrisInfo_t *game, unsigned long ms) {
+  game->clock.virtual_ms += ms;
+}
+
+// Best score of the leaderboard, the old text file is read if there is none
+void loadHighScore(TetrisInfo_t *game) {
+  Leaderboard_t board;
+  if (readLeaderboard(getScoresPath(), &board) && board.count > 0) {
+    game->high_score = (int)board.entry[0].score;
+  } else {
+    FILE *file = fopen("highscore_tetris.txt", "r");
+    if (file) {
+      fscanf(file, "%d", &game->high_score);
+      fclose(file);
+    }
+  }
+}
+
+// Once per game, the disk is left to the writer thread of postScore()
+void saveHighScore(TetrisInfo_t *game) {
+  if (game->persistent && !game->score_saved && game->score > 0) {
+    ScoreEntry_t entry = {.score = (uint32_t)game->score,
+                          .time = (uint64_t)time(NULL)};
+    postScore(entry);
+    game->score_saved = true;
   }
 }
 
@@ -186,138 +370,410 @@ bool coordinateInField(const int x, const int y) {
   return x >= 0 && x < kCols && y >= 0 && y < kRows;
 }
 
-bool figureCannotMove(const int x, const int y, const int field_cell) {
-  return x < 0 || x >= kCols || y >= kRows || field_cell == 1;
+// Mask still lies inside the field after moving its column 0 to column x
+bool rowMaskFits(Row_t mask, int x) {
+  bool fits;
+  if (x < 0) {
+    fits = x > -kFigCols ? (mask & (((Row_t)1 << -x) - 1u)) == 0 : mask == 0;
+  } else {
+    // Columns that stay on the board after the shift, nothing is shifted out
+    fits = x < kCols ? (mask & (Row_t)~(FULL_ROW >> x)) == 0 : mask == 0;
+  }
+  return fits;
+}
+
+Row_t shiftRowMask(Row_t mask, int x) {
+  return (Row_t)((x < 0 ? (uint64_t)mask >> -x : (uint64_t)mask << x) &
+                 FULL_ROW);
+}
+
+// Every orientation of every tetromino: row masks of the 4x4 box (bit j is
+// column j), occupied cells as {x, y} and the bounding box. Rotation 0 is the
+// spawn orientation, each next one is a clockwise turn.
+const Orientation_t kOrientations[kTetrominoes][kRotations] = {
+    {
+        {{0x0, 0xF, 0x0, 0x0}, {{0, 1}, {1, 1}, {2, 1}, {3, 1}}, {0, 1, 3, 1}},
+        {{0x4, 0x4, 0x4, 0x4}, {{2, 0}, {2, 1}, {2, 2}, {2, 3}}, {2, 0, 2, 3}},
+        {{0x0, 0x0, 0xF, 0x0}, {{0, 2}, {1, 2}, {2, 2}, {3, 2}}, {0, 2, 3, 2}},
+        {{0x2, 0x2, 0x2, 0x2}, {{1, 0}, {1, 1}, {1, 2}, {1, 3}}, {1, 0, 1, 3}}
+    },  // kFigureI
+    {
+        {{0x0, 0x7, 0x1, 0x0}, {{0, 1}, {1, 1}, {2, 1}, {0, 2}}, {0, 1, 2, 2}},
+        {{0x3, 0x2, 0x2, 0x0}, {{0, 0}, {1, 0}, {1, 1}, {1, 2}}, {0, 0, 1, 2}},
+        {{0x4, 0x7, 0x0, 0x0}, {{2, 0}, {0, 1}, {1, 1}, {2, 1}}, {0, 0, 2, 1}},
+        {{0x2, 0x2, 0x6, 0x0}, {{1, 0}, {1, 1}, {1, 2}, {2, 2}}, {1, 0, 2, 2}}
+    },  // kFigureL
+    {
+        {{0x6, 0x6, 0x0, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {2, 1}}, {1, 0, 2, 1}},
+        {{0x6, 0x6, 0x0, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {2, 1}}, {1, 0, 2, 1}},
+        {{0x6, 0x6, 0x0, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {2, 1}}, {1, 0, 2, 1}},
+        {{0x6, 0x6, 0x0, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {2, 1}}, {1, 0, 2, 1}}
+    },  // kFigureO
+    {
+        {{0x0, 0x7, 0x2, 0x0}, {{0, 1}, {1, 1}, {2, 1}, {1, 2}}, {0, 1, 2, 2}},
+        {{0x2, 0x3, 0x2, 0x0}, {{1, 0}, {0, 1}, {1, 1}, {1, 2}}, {0, 0, 1, 2}},
+        {{0x2, 0x7, 0x0, 0x0}, {{1, 0}, {0, 1}, {1, 1}, {2, 1}}, {0, 0, 2, 1}},
+        {{0x2, 0x6, 0x2, 0x0}, {{1, 0}, {1, 1}, {2, 1}, {1, 2}}, {1, 0, 2, 2}}
+    },  // kFigureT
+    {
+        {{0x0, 0x6, 0x3, 0x0}, {{1, 1}, {2, 1}, {0, 2}, {1, 2}}, {0, 1, 2, 2}},
+        {{0x1, 0x3, 0x2, 0x0}, {{0, 0}, {0, 1}, {1, 1}, {1, 2}}, {0, 0, 1, 2}},
+        {{0x6, 0x3, 0x0, 0x0}, {{1, 0}, {2, 0}, {0, 1}, {1, 1}}, {0, 0, 2, 1}},
+        {{0x2, 0x6, 0x4, 0x0}, {{1, 0}, {1, 1}, {2, 1}, {2, 2}}, {1, 0, 2, 2}}
+    },  // kFigureS
+    {
+        {{0x0, 0x3, 0x6, 0x0}, {{0, 1}, {1, 1}, {1, 2}, {2, 2}}, {0, 1, 2, 2}},
+        {{0x2, 0x3, 0x1, 0x0}, {{1, 0}, {0, 1}, {1, 1}, {0, 2}}, {0, 0, 1, 2}},
+        {{0x3, 0x6, 0x0, 0x0}, {{0, 0}, {1, 0}, {1, 1}, {2, 1}}, {0, 0, 2, 1}},
+        {{0x4, 0x6, 0x2, 0x0}, {{2, 0}, {1, 1}, {2, 1}, {1, 2}}, {1, 0, 2, 2}}
+    },  // kFigureZ
+    {
+        {{0x0, 0x7, 0x4, 0x0}, {{0, 1}, {1, 1}, {2, 1}, {2, 2}}, {0, 1, 2, 2}},
+        {{0x2, 0x2, 0x3, 0x0}, {{1, 0}, {1, 1}, {0, 2}, {1, 2}}, {0, 0, 1, 2}},
+        {{0x1, 0x7, 0x0, 0x0}, {{0, 0}, {0, 1}, {1, 1}, {2, 1}}, {0, 0, 2, 1}},
+        {{0x6, 0x2, 0x2, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {1, 2}}, {1, 0, 2, 2}}
+    }};  // kFigureJ
+
+const Orientation_t *figureShape(const Figure_t *fig) {
+  return &kOrientations[fig->type][fig->rotation];
 }
 
-void copyTetromino(int dst_fig[kFigRows][kFigCols],
-                   int src_fig[kFigRows][kFigCols]) {
-  for (int i = 0; i < kFigRows; i++) {
-    for (int j = 0; j < kFigCols; j++) {
-      dst_fig[i][j] = src_fig[i][j];
+void setFigure(Figure_t *ptr_fig, Tetromino_t type) {
+  ptr_fig->type = type;
+  ptr_fig->rotation = 0;
+}
+
+// Output step of splitmix64
+static uint64_t mixBits(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// splitmix64 spreads any seed over the whole xoshiro128** state
+void seedRng(Rng_t *rng, uint64_t seed) {
+  for (int i = 0; i < 4; i += 2) {
+    uint64_t z = mixBits(seed += 0x9E3779B97F4A7C15ULL);
+    rng->s[i] = (uint32_t)z;
+    rng->s[i + 1] = (uint32_t)(z >> 32);
+  }
+}
+
+static uint32_t rotl32(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+// xoshiro128**
+uint32_t nextRandom(Rng_t *rng) {
+  uint32_t *s = rng->s;
+  uint32_t result = rotl32(s[1] * 5, 7) * 9;
+  uint32_t t = s[1] << 9;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl32(s[3], 11);
+  return result;
+}
+
+int randomBelow(Rng_t *rng, int bound) {
+  return (int)(((uint64_t)nextRandom(rng) * (uint32_t)bound) >> 32);
+}
+
+void seedTetrisGame(TetrisInfo_t *game, uint64_t seed) {
+  seedRng(&game->generator.rng, seed);
+  game->generator.bag_left = 0;
+  game->next_empty = true;
+}
+
+void setRandomizer(TetrisInfo_t *game, Randomizer_t randomizer) {
+  game->generator.randomizer = randomizer;
+  game->generator.bag_left = 0;
+}
+
+Tetromino_t drawFigure(TetrisInfo_t *game) {
+  Tetromino_t type;
+  if (game->generator.randomizer == kRandomizerBag) {
+    Tetromino_t *bag = game->generator.bag;
+    if (game->generator.bag_left == 0) {
+      for (int i = 0; i < kTetrominoes; i++) {
+        bag[i] = (Tetromino_t)i;
+      }
+      game->generator.bag_left = kTetrominoes;
     }
+    // Take a random figure out of the bag and close the gap with the last one
+    int left = --game->generator.bag_left;
+    int pick = randomBelow(&game->generator.rng, left + 1);
+    type = bag[pick];
+    bag[pick] = bag[left];
+  } else {
+    type = (Tetromino_t)randomBelow(&game->generator.rng, kTetrominoes);
   }
+  return type;
 }
 
-void setFigure(Figure_t *ptr_fig, Tetromino_t type) {
-  static int tetrominoes[7][kFigRows][kFigCols] = {
-      // change start rotation to fit in 2 rows. change rotation functions ???
-      {{0, 0, 0, 0}, {1, 1, 1, 1}, {0, 0, 0, 0}, {0, 0, 0, 0}},   // kFigureI
-      {{0, 0, 0, 0}, {1, 1, 1, 0}, {1, 0, 0, 0}, {0, 0, 0, 0}},   // kFigureL
-      {{0, 1, 1, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}},   // kFigureO
-      {{0, 0, 0, 0}, {1, 1, 1, 0}, {0, 1, 0, 0}, {0, 0, 0, 0}},   // kFigureT
-      {{0, 0, 0, 0}, {0, 1, 1, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}},   // kFigureS
-      {{0, 0, 0, 0}, {1, 1, 0, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}},   // kFigureZ
-      {{0, 0, 0, 0}, {1, 1, 1, 0}, {0, 0, 1, 0}, {0, 0, 0, 0}}};  // kFigureJ
-  copyTetromino(ptr_fig->cell, tetrominoes[type]);
-  ptr_fig->type = type;
+// Where generateNextFigure() puts a new figure of the type
+Point_t spawnCoordinate(Tetromino_t type) {
+  bool wide = type == kFigureI || type == kFigureO;
+  Point_t spawn = {.x = wide ? kCols / 2 - 2 : kCols / 2 - 1,
+                   .y = wide ? -2 : -3};
+  return spawn;
+}
+
+int peekNextFigures(TetrisInfo_t *game, Tetromino_t *types, int count) {
+  if (count > kQueueSize) {
+    count = kQueueSize;
+  }
+  for (int i = 0; i < count; i++) {
+    types[i] = game->generator.queue[(game->generator.head + i) % kQueueSize];
+  }
+  return count;
 }
 
-void generateNextFigure() {
-  TetrisInfo_t *game = getTetrisInfo();
-  Tetromino_t type = rand() % 7;
-  // Generate next tetromino if empty (start of game)
-  static bool next_empty = true;
-  if (next_empty) {
-    setFigure(&game->next.fig, type);
-    type = rand() % 7;
-    next_empty = false;
-  }
-  setFigure(&game->current.fig, game->next.fig.type);
-  game->current.coordinate.x =
-      (game->current.fig.type == kFigureI || game->current.fig.type == kFigureO
-           ? 3
-           : 4);
-  game->current.coordinate.y =
-      (game->current.fig.type == kFigureI || game->current.fig.type == kFigureO
-           ? -2
-           : -3);
-  setFigure(&game->next.fig, type);
-}
-
-void onStartState(UserAction_t action) {
+void generateNextFigure(TetrisInfo_t *game) {
+  // Fill the lookahead queue if empty (start of game)
+  if (game->next_empty) {
+    for (int i = 0; i < kQueueSize; i++) {
+      game->generator.queue[i] = drawFigure(game);
+    }
+    game->generator.head = 0;
+    game->next_empty = false;
+  }
+  int head = game->generator.head;
+  setFigure(&game->current.fig, game->generator.queue[head]);
+  game->pieces++;
+  game->generator.queue[head] = drawFigure(game);
+  game->generator.head = (head + 1) % kQueueSize;
+  markChanged(game);
+  game->current.coordinate = spawnCoordinate(game->current.fig.type);
+  setFigure(&game->next.fig, game->generator.queue[game->generator.head]);
+}
+
+void onStartState(TetrisInfo_t *game, UserAction_t action) {
   switch (action) {
     case Start:
-      generateNextFigure();
-      setState(kMoving);
+      generateNextFigure(game);
+      setState(game, kMoving);
       break;
     case Terminate:
-      handleTerminateState();
+      handleTerminateState(game);
       break;
     default:
       break;
   }
 }
 
-void onPauseState(UserAction_t action) {
-  TetrisInfo_t *game = getTetrisInfo();
+void onPauseState(TetrisInfo_t *game, UserAction_t action) {
   switch (action) {
     case Pause:
-      setState(kMoving);
+      setState(game, kMoving);
       game->pause = 0;
       break;
     case Terminate:
-      handleTerminateState();
+      handleTerminateState(game);
       break;
     default:
       break;
   }
 }
 
-int getLowestCoordinate() {
-  TetrisInfo_t *game = getTetrisInfo();
-  int lowest_row = 0;
-  for (int i = kFigRows - 1; i > 0 && lowest_row == 0; i--) {
-    for (int j = 0; j < kFigCols && lowest_row == 0; j++) {
-      if (game->current.fig.cell[i][j]) {
-        lowest_row = i;
-      }
-    }
-  }
-  return game->current.coordinate.y + lowest_row;
+int getLowestCoordinate(TetrisInfo_t *game) {
+  const Orientation_t *shape = figureShape(&game->current.fig);
+  return game->current.coordinate.y + shape->box.bottom;
 }
 
-bool checkGameOver() {
+bool checkGameOver(TetrisInfo_t *game) {
   bool game_over = false;
   // If figure was attched in row 0
-  if (getLowestCoordinate() <= 0) {
+  if (getLowestCoordinate(game) <= 0) {
     game_over = true;
   }
   return game_over;
 }
 
-bool isLineFill(int line) {
-  TetrisInfo_t *game = getTetrisInfo();
-  bool line_is_fill = true;
-  for (int j = 0; j < kCols && line_is_fill; j++) {
-    if (game->field.cell[line][j] == false) {
-      line_is_fill = false;
+// Removes the full rows among top..bottom and drops everything above them in
+// one pass, the result lists the removed rows from top to bottom
+LinesCleared_t clearFullLines(Field_t *field, int top, int bottom) {
+  LinesCleared_t cleared = {0};
+  top = top < 0 ? 0 : top;
+  bottom = bottom >= kRows ? kRows - 1 : bottom;
+  for (int line = top; line <= bottom; line++) {
+    if (field->row[line] == FULL_ROW) {
+      cleared.rows[cleared.count++] = line;
+    }
+  }
+  if (cleared.count > 0) {
+    // Only the rows above the lowest cleared one change
+    int last = cleared.rows[cleared.count - 1];
+    Row_t before[kRows];
+    memcpy(before, field->row, (last + 1) * sizeof(Row_t));
+    int write = bottom;
+    for (int read = bottom; read >= top; read--) {
+      if (field->row[read] != FULL_ROW) {
+        field->fill[write] = field->fill[read];
+        field->row[write--] = field->row[read];
+      }
+    }
+    memmove(&field->row[cleared.count], &field->row[0], top * sizeof(Row_t));
+    memmove(&field->fill[cleared.count], &field->fill[0], top);
+    memset(field->row, 0, cleared.count * sizeof(Row_t));
+    memset(field->fill, 0, cleared.count);
+    // Keys are per cell, so a line only adds the cells that flipped
+    uint64_t flipped = 0;
+    for (int line = 0; line <= last; line++) {
+      Row_t flips = before[line] ^ field->row[line];
+      if (flips) {
+        flipped ^= rowKey(line, flips);
+      }
     }
+    field->hash ^= flipped;
+    updateHeights(field);
   }
-  return line_is_fill;
+  return cleared;
 }
 
-void moveGroundDown(int line) {
-  TetrisInfo_t *game = getTetrisInfo();
-  for (int i = line; i > 0; i--) {
-    for (int j = 0; j < kCols; j++) {
-      game->field.cell[i][j] = game->field.cell[i - 1][j];
+// Every column had a cell in each removed row, so heights are found again by
+// walking down from the top until all columns are seen
+void updateHeights(Field_t *field) {
+  Row_t seen = 0;
+  memset(field->height, 0, sizeof(field->height));
+  for (int line = 0; line < kRows && seen != FULL_ROW; line++) {
+    Row_t fresh = field->row[line] & (Row_t)~seen;
+    for (; fresh; fresh &= fresh - 1) {
+      field->height[__builtin_ctzll(fresh)] = kRows - line;
     }
+    seen |= field->row[line];
   }
-  for (int j = 0; j < kCols; j++) {
-    game->field.cell[0][j] = 0;
+}
+
+// Rebuilds heights, fill counts and the hash after the rows were written
+// directly
+void syncFieldMeta(Field_t *field) {
+  for (int line = 0; line < kRows; line++) {
+    field->fill[line] = __builtin_popcountll(field->row[line]);
   }
+  updateHeights(field);
+  field->hash = rowsKey(field->row);
 }
 
-void handleAttaching() {
-  TetrisInfo_t *game = getTetrisInfo();
-  int count_filled_lines = 0;
+// Zobrist key of a filled cell, the splitmix64 sequence at the cell index
+uint64_t cellKey(int line, int column) {
+  return mixBits((uint64_t)(line * kCols + column + 1) *
+                 0x9E3779B97F4A7C15ULL);
+}
+
+// XOR of cellKey() over every 4-cell run of every line, so that a row costs
+// one lookup per 4 columns. Filled before main(), any thread reads it
+// without a lock
+static uint64_t nibble_keys[kRows][(kCols + 3) / 4][16];
+
+__attribute__((constructor)) static void fillNibbleKeys(void) {
   for (int line = 0; line < kRows; line++) {
-    if (isLineFill(line)) {
-      count_filled_lines += 1;
-      moveGroundDown(line);
+    for (int column = 0; column < kCols; column++) {
+      uint64_t key = cellKey(line, column);
+      for (int bits = 0; bits < 16; bits++) {
+        nibble_keys[line][column / 4][bits] ^=
+            bits >> column % 4 & 1 ? key : 0;
+      }
+    }
+  }
+}
+
+// A fixed count of lookups, no branch depends on the cells
+uint64_t rowKey(int line, Row_t row) {
+  uint64_t key = 0;
+  for (int nibble = 0; nibble < (kCols + 3) / 4; nibble++) {
+    key ^= nibble_keys[line][nibble][row >> 4 * nibble & 15];
+  }
+  return key;
+}
+
+// Key of the empty field, not 0 so that tables can cache it like any other
+static const uint64_t kEmptyFieldKey = 0x6A09E667F3BCC908ULL;
+
+// Hash of bare rows, kEmptyFieldKey for the empty field
+uint64_t rowsKey(const Row_t *rows) {
+  uint64_t key = kEmptyFieldKey;
+  for (int line = 0; line < kRows; line++) {
+    key ^= rowKey(line, rows[line]);
+  }
+  return key;
+}
+
+// Hash of the board an unseen figure would leave, line clears aside
+uint64_t figureKey(const Orientation_t *shape, int x, int y) {
+  uint64_t key = 0;
+  for (int k = 0; k < kFigCells; k++) {
+    int column = x + shape->cell[k].x;
+    int line = y + shape->cell[k].y;
+    key ^= coordinateInField(column, line)
+               ? nibble_keys[line][column / 4][1 << column % 4]
+               : 0;
+  }
+  return key;
+}
+
+// Puts a figure into the field for good and updates the metadata
+void lockFigure(Field_t *field, const Orientation_t *shape, int x, int y) {
+  for (int k = 0; k < kFigCells; k++) {
+    int column = x + shape->cell[k].x;
+    int line = y + shape->cell[k].y;
+    if (coordinateInField(column, line)) {
+      Row_t bit = (Row_t)((Row_t)1 << column);
+      if ((field->row[line] & bit) == 0) {
+        field->fill[line]++;
+        field->hash ^= nibble_keys[line][column / 4][1 << column % 4];
+      }
+      field->row[line] |= bit;
+      if (field->height[column] < kRows - line) {
+        field->height[column] = kRows - line;
+      }
+    }
+  }
+}
+
+// Rows a figure falls from (x, y) until it lands, from the column heights.
+// Negative when a cell is below the top of its column, under an overhang
+int dropDistance(const Field_t *field, const Orientation_t *shape, int x,
+                 int y) {
+  int distance = kRows;
+  for (int k = 0; k < kFigCells && distance >= 0; k++) {
+    int column = x + shape->cell[k].x;
+    int free_rows = kRows - field->height[column] - 1 - (y + shape->cell[k].y);
+    distance = free_rows < distance ? free_rows : distance;
+  }
+  return distance;
+}
+
+int ghostY(const TetrisInfo_t *game) {
+  const Orientation_t *shape = figureShape(&game->current.fig);
+  int x = game->current.coordinate.x;
+  int y = game->current.coordinate.y;
+  int distance = dropDistance(&game->field, shape, x, y);
+  if (distance < 0) {
+    // Slower path under overhangs, the heights do not see the gap
+    for (distance = 0; figureFits(game->field.row, shape, x, y + distance + 1);
+         distance++) {
     }
   }
+  return y + distance;
+}
+
+// Rows between the floor and the lowest cell of the figure after a hard drop
+int landingHeight(const TetrisInfo_t *game) {
+  const Orientation_t *shape = figureShape(&game->current.fig);
+  return kRows - 1 - (ghostY(game) + shape->box.bottom);
+}
+
+// Only the rows of the figure that has just landed can become full
+LinesCleared_t handleAttaching(TetrisInfo_t *game) {
+  PROFILE_START(attaching);
+  const Orientation_t *shape = figureShape(&game->current.fig);
+  int y = game->current.coordinate.y;
+  lockFigure(&game->field, shape, game->current.coordinate.x, y);
+  LinesCleared_t cleared =
+      clearFullLines(&game->field, y + shape->box.top, y + shape->box.bottom);
+  int count_filled_lines = cleared.count;
+  game->last_cleared = cleared;
   // Earn points              // bonus part 2
   switch (count_filled_lines) {
     case 1:
@@ -336,12 +792,13 @@ void handleAttaching() {
   if (game->score > game->high_score) {
     game->high_score = game->score;
   }
+  markChanged(game);
 #ifndef NO_LIMITS
   // Set new level necessary  // bonus part 3
-  if (count_filled_lines > 0 && game->level < 10) {
+  if (count_filled_lines > 0 && game->level < kMaxLevel) {
     game->level = game->score / 600;
-    if (game->level > 10) {
-      game->level = 10;
+    if (game->level > kMaxLevel) {
+      game->level = kMaxLevel;
     }
     // Set new speed necessary  // bonus part 3
     game->speed = game->level;
@@ -355,347 +812,103 @@ void handleAttaching() {
     game->update_interval = 1000 - game->speed * 75;
   }
 #endif  // NO_LIMITS
-  game->current.hash_all_rotation = 0;
-  game->current.rotation = 0;
-}
-
-bool checkNewPosition() {
-  TetrisInfo_t *game = getTetrisInfo();
-  bool can_move = true;
-  for (int i = 0; i < kFigRows && can_move; i++) {
-    for (int j = 0; j < kFigCols && can_move; j++) {
-      if (game->current.fig.cell[i][j]) {
-        int new_x = game->current.coordinate.x + game->current.offset_x + j;
-        int new_y = game->current.coordinate.y + game->current.offset_y + i;
-        if (figureCannotMove(new_x, new_y, game->field.cell[new_y][new_x])) {
-          can_move = false;
-        }
+  PROFILE_STOP(attaching, kProfileHandleAttaching);
+  return cleared;
+}
+
+bool checkNewPosition(TetrisInfo_t *game) {
+  int new_x = game->current.coordinate.x + game->current.offset_x;
+  int new_y = game->current.coordinate.y + game->current.offset_y;
+  return figureFits(game->field.row, figureShape(&game->current.fig), new_x,
+                    new_y);
+}
+
+// Collision test of a figure with its 4x4 box at (x, y) against any field
+bool figureFits(const Row_t *field, const Orientation_t *shape, int x, int y) {
+  bool fits = true;
+  for (int i = 0; i < kFigRows && fits; i++) {
+    Row_t mask = shape->row[i];
+    int line = y + i;
+    if (mask) {
+      // Rows above the field are free, the floor and the walls are not
+      if (line >= kRows || !rowMaskFits(mask, x)) {
+        fits = false;
+      } else if (line >= 0 && (field[line] & shiftRowMask(mask, x))) {
+        fits = false;
       }
     }
   }
-  return can_move;
+  return fits;
 }
 
-void addFigureOnField() {
-  TetrisInfo_t *game = getTetrisInfo();
-  for (int i = 0; i < kFigRows; i++) {
-    for (int j = 0; j < kFigCols; j++) {
-      if (game->current.fig.cell[i][j]) {
-        int new_x = game->current.coordinate.x + game->current.offset_x + j;
-        int new_y = game->current.coordinate.y + game->current.offset_y + i;
-        if (coordinateInField(new_x, new_y)) {
-          game->field.cell[new_y][new_x] = game->current.fig.cell[i][j];
-        }
+// The locked field with the falling figure on top, only frames need it
+void composeField(const TetrisInfo_t *game, Row_t *rows) {
+  memcpy(rows, game->field.row, kRows * sizeof(Row_t));
+  if (game->state == kMoving || game->state == kPause) {
+    const Orientation_t *shape = figureShape(&game->current.fig);
+    for (int i = 0; i < kFigRows; i++) {
+      int line = game->current.coordinate.y + i;
+      if (line >= 0 && line < kRows) {
+        rows[line] |= shiftRowMask(shape->row[i], game->current.coordinate.x);
       }
     }
   }
 }
 
-bool tryMoveFigure(UserAction_t action) {
-  TetrisInfo_t *game = getTetrisInfo();
-
+bool tryMoveFigure(TetrisInfo_t *game, UserAction_t action) {
   game->current.offset_x -= (action == Left);
   game->current.offset_x += (action == Right);
   game->current.offset_y = (action == Down);
 
-  eraseCurrentFigureOnField();
-
-  bool can_move = checkNewPosition();
+  // The field holds only locked cells, a move touches the figure alone
+  bool can_move = checkNewPosition(game);
 
   if (can_move) {
-    addFigureOnField();
     game->current.coordinate.x += game->current.offset_x;
     game->current.coordinate.y += game->current.offset_y;
-    game->current.offset_x = 0;
-    game->current.offset_y = 0;
-  } else {
-    game->current.offset_x = 0;
-    game->current.offset_y = 0;
-    addFigureOnField();
+    markChanged(game);
   }
+  game->current.offset_x = 0;
+  game->current.offset_y = 0;
   return can_move;
 }
 
-void rotateCurrentFigure() {
-  TetrisInfo_t *game = getTetrisInfo();
-  game->current.rotation = game->current.hash_all_rotation % 4;
-  switch (game->current.fig.type) {
-    case kFigureI:
-      rotateFigureI();
-      break;
-    case kFigureL:
-      rotateFigureL();
-      break;
-    case kFigureT:
-      rotateFigureT();
-      break;
-    case kFigureS:
-      rotateFigureS();
-      break;
-    case kFigureZ:
-      rotateFigureZ();
-      break;
-    case kFigureJ:
-      rotateFigureJ();
-      break;
-    case kFigureO:
-      break;
-  }
-}
-
-void eraseCurrentFigureOnField() {
-  TetrisInfo_t *game = getTetrisInfo();
-  for (int i = 0; i < kFigRows; i++) {
-    for (int j = 0; j < kFigCols; j++) {
-      if (game->current.fig.cell[i][j]) {
-        int fx = game->current.coordinate.x + j;
-        int fy = game->current.coordinate.y + i;
-        if (coordinateInField(fx, fy)) {
-          game->field.cell[fy][fx] = 0;
-        }
-      }
-    }
-  }
-}
-
-void onGameOverState(UserAction_t action) {
+void onGameOverState(TetrisInfo_t *game, UserAction_t action) {
   switch (action) {
     case Start:
-      clearTetrisInfo();
-      generateNextFigure();
-      setState(kMoving);
+      clearTetrisInfo(game);
+      generateNextFigure(game);
+      setState(game, kMoving);
       break;
     case Terminate:
-      handleTerminateState();
+      handleTerminateState(game);
       break;
     default:
       break;
   }
 }
 
-void dropFigure() {
-  while (tryMoveFigure(Down) == true) {
+void dropFigure(TetrisInfo_t *game) {
+  PROFILE_START(drop);
+  int distance = ghostY(game) - game->current.coordinate.y;
+  if (distance > 0) {
+    game->current.coordinate.y += distance;
+    markChanged(game);
   }
+  PROFILE_STOP(drop, kProfileDropFigure);
 }
 
-bool tryRotateFigure() {
-  TetrisInfo_t *game = getTetrisInfo();
-
-  eraseCurrentFigureOnField();
+bool tryRotateFigure(TetrisInfo_t *game) {
+  int rotation = game->current.fig.rotation;
+  game->current.fig.rotation = (rotation + 1) % kRotations;
 
-  game->current.hash_all_rotation += 1;
-  rotateCurrentFigure();
-
-  bool can_move = checkNewPosition();
+  bool can_move = checkNewPosition(game);
 
   if (can_move) {
-    addFigureOnField();
+    markChanged(game);
   } else {
     // Turn back last position
-    game->current.hash_all_rotation -= 1;
-    rotateCurrentFigure();
-    addFigureOnField();
+    game->current.fig.rotation = rotation;
   }
   return can_move;
 }
-
-void clearCurrentFigure() {
-  TetrisInfo_t *game = getTetrisInfo();
-  game->current.fig.cell[0][0] = 0;
-  game->current.fig.cell[0][1] = 0;
-  game->current.fig.cell[0][2] = 0;
-  game->current.fig.cell[0][3] = 0;
-  game->current.fig.cell[1][0] = 0;
-  game->current.fig.cell[1][1] = 0;
-  game->current.fig.cell[1][2] = 0;
-  game->current.fig.cell[1][3] = 0;
-  game->current.fig.cell[2][0] = 0;
-  game->current.fig.cell[2][1] = 0;
-  game->current.fig.cell[2][2] = 0;
-  game->current.fig.cell[2][3] = 0;
-  game->current.fig.cell[3][0] = 0;
-  game->current.fig.cell[3][1] = 0;
-  game->current.fig.cell[3][2] = 0;
-  game->current.fig.cell[3][3] = 0;
-}
-
-void rotateFigureI() {
-  TetrisInfo_t *game = getTetrisInfo();
-  clearCurrentFigure();
-  switch (game->current.rotation) {
-    case 1:
-      game->current.fig.cell[0][2] = 1;  //  . .[] .
-      game->current.fig.cell[1][2] = 1;  //  . .[] .
-      game->current.fig.cell[2][2] = 1;  //  . .[] .
-      game->current.fig.cell[3][2] = 1;  //  . .[] .
-      break;
-    case 2:
-      game->current.fig.cell[2][0] = 1;  //  . . . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      game->current.fig.cell[2][2] = 1;  // [][][][]
-      game->current.fig.cell[2][3] = 1;  //  . . . .
-      break;
-    case 3:
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][1] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  .[] . .
-      game->current.fig.cell[3][1] = 1;  //  .[] . .
-      break;
-    case 0:
-      game->current.fig.cell[1][0] = 1;  //  . . . .
-      game->current.fig.cell[1][1] = 1;  // [][][][]
-      game->current.fig.cell[1][2] = 1;  //  . . . .
-      game->current.fig.cell[1][3] = 1;  //  . . . .
-      break;
-  }
-}
-void rotateFigureJ() {
-  TetrisInfo_t *game = getTetrisInfo();
-  clearCurrentFigure();
-  switch (game->current.rotation) {
-    case 1:
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][1] = 1;  //  .[] . .
-      game->current.fig.cell[2][0] = 1;  // [][] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-    case 2:
-      game->current.fig.cell[0][0] = 1;  // [] . . .
-      game->current.fig.cell[1][0] = 1;  // [][][] .
-      game->current.fig.cell[1][1] = 1;  //  . . . .
-      game->current.fig.cell[1][2] = 1;  //  . . . .
-      break;
-    case 3:
-      game->current.fig.cell[0][1] = 1;  //  .[][] .
-      game->current.fig.cell[0][2] = 1;  //  .[] . .
-      game->current.fig.cell[1][1] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-    case 0:
-      game->current.fig.cell[1][0] = 1;  //  . . . .
-      game->current.fig.cell[1][1] = 1;  // [][][] .
-      game->current.fig.cell[1][2] = 1;  //  . .[] .
-      game->current.fig.cell[2][2] = 1;  //  . . . .
-      break;
-  }
-}
-void rotateFigureT() {
-  TetrisInfo_t *game = getTetrisInfo();
-  clearCurrentFigure();
-  switch (game->current.rotation) {
-    case 1:
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][0] = 1;  // [][] . .
-      game->current.fig.cell[1][1] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-    case 2:
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][0] = 1;  // [][][] .
-      game->current.fig.cell[1][1] = 1;  //  . . . .
-      game->current.fig.cell[1][2] = 1;  //  . . . .
-      break;
-    case 3:
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][1] = 1;  //  .[][] .
-      game->current.fig.cell[1][2] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-    case 0:
-      game->current.fig.cell[1][0] = 1;  //  . . . .
-      game->current.fig.cell[1][1] = 1;  // [][][] .
-      game->current.fig.cell[1][2] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-  }
-}
-void rotateFigureS() {
-  TetrisInfo_t *game = getTetrisInfo();
-  clearCurrentFigure();
-  switch (game->current.rotation) {
-    case 1:
-      game->current.fig.cell[0][0] = 1;  // [] . . .
-      game->current.fig.cell[1][0] = 1;  // [][] . .
-      game->current.fig.cell[1][1] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-    case 2:
-      game->current.fig.cell[0][1] = 1;  //  .[][] .
-      game->current.fig.cell[0][2] = 1;  // [][] . .
-      game->current.fig.cell[1][0] = 1;  //  . . . .
-      game->current.fig.cell[1][1] = 1;  //  . . . .
-      break;
-    case 3:
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][1] = 1;  //  .[][] .
-      game->current.fig.cell[1][2] = 1;  //  . .[] .
-      game->current.fig.cell[2][2] = 1;  //  . . . .
-      break;
-    case 0:
-      game->current.fig.cell[1][1] = 1;  //  . . . .
-      game->current.fig.cell[1][2] = 1;  //  .[][] .
-      game->current.fig.cell[2][0] = 1;  // [][] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-  }
-}
-void rotateFigureZ() {
-  TetrisInfo_t *game = getTetrisInfo();
-  clearCurrentFigure();
-  switch (game->current.rotation) {
-    case 1:
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][0] = 1;  // [][] . .
-      game->current.fig.cell[1][1] = 1;  // [] . . .
-      game->current.fig.cell[2][0] = 1;  //  . . . .
-      break;
-    case 2:
-      game->current.fig.cell[0][0] = 1;  // [][] . .
-      game->current.fig.cell[0][1] = 1;  //  .[][] .
-      game->current.fig.cell[1][1] = 1;  //  . . . .
-      game->current.fig.cell[1][2] = 1;  //  . . . .
-      break;
-    case 3:
-      game->current.fig.cell[0][2] = 1;  //  . .[] .
-      game->current.fig.cell[1][1] = 1;  //  .[][] .
-      game->current.fig.cell[1][2] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-    case 0:
-      game->current.fig.cell[1][0] = 1;  //  . . . .
-      game->current.fig.cell[1][1] = 1;  // [][] . .
-      game->current.fig.cell[2][1] = 1;  //  .[][] .
-      game->current.fig.cell[2][2] = 1;  //  . . . .
-      break;
-  }
-}
-void rotateFigureL() {
-  TetrisInfo_t *game = getTetrisInfo();
-  clearCurrentFigure();
-  switch (game->current.rotation) {
-    case 1:
-      game->current.fig.cell[0][0] = 1;  // [][] . .
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][1] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  . . . .
-      break;
-    case 2:
-      game->current.fig.cell[0][2] = 1;  //  . .[] .
-      game->current.fig.cell[1][0] = 1;  // [][][] .
-      game->current.fig.cell[1][1] = 1;  //  . . . .
-      game->current.fig.cell[1][2] = 1;  //  . . . .
-      break;
-    case 3:
-      game->current.fig.cell[0][1] = 1;  //  .[] . .
-      game->current.fig.cell[1][1] = 1;  //  .[] . .
-      game->current.fig.cell[2][1] = 1;  //  .[][] .
-      game->current.fig.cell[2][2] = 1;  //  . . . .
-      break;
-    case 0:
-      game->current.fig.cell[1][0] = 1;  //  . . . .
-      game->current.fig.cell[1][1] = 1;  // [][][] .
-      game->current.fig.cell[1][2] = 1;  // [] . . .
-      game->current.fig.cell[2][0] = 1;  //  . . . .
-      break;
-  }
-}
@@ -1,7 +1,9 @@
 #ifndef BRICK_GAME_TETRIS_H_
 #define BRICK_GAME_TETRIS_H_
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,10 +23,26 @@ typedef enum {
 typedef enum {
   kFigCols = 4,
   kFigRows = 4,
-  kCols = 10,
-  kRows = 20
+  kCols = BOARD_COLS,
+  kRows = BOARD_ROWS,
+  kFigCells = 4,
+  kRotations = 4,
+  kTetrominoes = 7,
+  kQueueSize = 8
 } Sizes_t;
 
+/** Level and speed stop growing here unless built with NO_LIMITS */
+typedef enum { kMaxLevel = 10 } LevelLimits_t;
+
+/** One board or figure row: bit j is set when column j is occupied */
+typedef BoardRow_t Row_t;
+
+#define FULL_ROW ((Row_t)((Row_t)~(Row_t)0 >> (8 * sizeof(Row_t) - kCols)))
+
+_Static_assert(kRows == FRAME_ROWS && kCols == FRAME_COLS &&
+                   kFigRows == FRAME_NEXT,
+               "frames have the size of the board");
+
 typedef enum {
   kFigureI,
   kFigureL,
@@ -35,87 +53,218 @@ typedef enum {
   kFigureJ
 } Tetromino_t;
 
+/** How generateNextFigure() picks figures */
+typedef enum {
+  kRandomizerUniform,  // every figure independently
+  kRandomizerBag       // shuffled bags of all seven figures
+} Randomizer_t;
+
+/** State of the xoshiro128** generator */
+typedef struct {
+  uint32_t s[4];
+} Rng_t;
+
 typedef struct {
   int x;
   int y;
 } Point_t;
 
+typedef struct {
+  int left;
+  int top;
+  int right;
+  int bottom;
+} Box_t;
+
+/** One rotation of a tetromino inside its 4x4 box, see kOrientations */
+typedef struct {
+  Row_t row[kFigRows];
+  Point_t cell[kFigCells];
+  Box_t box;
+} Orientation_t;
+
+/** A figure is only an index into kOrientations */
 typedef struct {
   Tetromino_t type;
-  int *row[kFigRows];
-  int cell[kFigRows][kFigCols];
+  int rotation;
 } Figure_t;
 
+extern const Orientation_t kOrientations[kTetrominoes][kRotations];
+
+/** Playfield with metadata of the landed cells, see lockFigure() */
 typedef struct {
-  struct {
-    int *row[kRows];
-    int cell[kRows][kCols];
-  } field;
+  Row_t row[kRows];
+  uint8_t height[kCols];  // rows from the floor to the top landed cell
+  uint8_t fill[kRows];    // landed cells per row
+  uint64_t hash;          // rowsKey() of the landed cells
+} Field_t;
+
+/** Full rows removed by one landing, row indices before the removal */
+typedef struct {
+  int count;
+  int rows[kFigRows];
+} LinesCleared_t;
+
+/** Input log writer of replay.h */
+typedef struct Recorder Recorder_t;
+
+/** Frame writer of spectate.h */
+typedef struct Broadcaster Broadcaster_t;
+
+/** Returns milliseconds of a monotonic time line */
+typedef unsigned long (*TimeSource_t)(void *context);
+
+/**
+ * Two frames written in turn by the thread that runs the game, see
+ * publishFrame(). Other threads read the latest one in place between
+ * beginFrameRead() and endFrameRead(), a seqlock per frame tells them
+ * when the engine got around to overwrite it meanwhile.
+ */
+typedef struct {
+  atomic_ulong published;    // the latest frame is frame[published & 1]
+  atomic_ulong sequence[2];  // odd while the frame is written
+  Frame_t frame[2];
+} FrameBuffer_t;
+
+typedef struct {
+  int slot;
+  unsigned long sequence;
+} FrameTicket_t;
+
+/** Context of one game, create as many as needed with createTetrisGame() */
+typedef struct {
+  TetrisState_t state;
+
+  Field_t field;  // landed cells only, composeField() adds the falling figure
 
   struct {
     Figure_t fig;
   } next;
 
+  struct {
+    Rng_t rng;
+    Randomizer_t randomizer;
+    Tetromino_t bag[kTetrominoes];
+    int bag_left;
+    Tetromino_t queue[kQueueSize];  // upcoming figures, next.fig is at head
+    int head;
+  } generator;
+
   struct {
     Figure_t fig;
     Point_t coordinate;
     int offset_x;
     int offset_y;
-    int rotation;
-    int hash_all_rotation;
   } current;
 
   bool run_game;
+  bool next_empty;
+  bool persistent;   // load and post scores to the leaderboard
+  bool score_saved;  // this game is posted already
+  Recorder_t *recorder;  // NULL when the game is not recorded
+  Broadcaster_t *broadcaster;  // NULL when nobody can watch the game
   int level;
   int speed;
   int score;
   int high_score;
   int pause;
+  unsigned long pieces;           // figures spawned since the start
+  unsigned long version;          // grows with every visible change
+  LinesCleared_t last_cleared;    // result of the last handleAttaching()
   unsigned long last_tick;        // time
   unsigned long update_interval;  // time
+
+  struct {
+    TimeSource_t now;
+    void *context;
+    unsigned long virtual_ms;  // time of setVirtualClock()
+  } clock;
+
+  FrameBuffer_t frames;
+
+  // int** view handed out through GameInfo_t, filled by getGameInfo()
+  struct {
+    int *field[kRows];
+    int field_cells[kRows][kCols];
+    int *next[kFigRows];
+    int next_cells[kFigRows][kFigCols];
+    GameInfo_t info;
+    unsigned long version;  // game version the cells were expanded from
+  } view;
 } TetrisInfo_t;
 
-TetrisState_t *initState();
+TetrisInfo_t *createTetrisGame();
+void destroyTetrisGame(TetrisInfo_t *game);
+void tetrisUserInput(TetrisInfo_t *game, UserAction_t action, bool hold);
+GameInfo_t tetrisUpdateCurrentState(TetrisInfo_t *game);
+bool applyGravity(TetrisInfo_t *game);
+GameInfo_t *getGameInfo(TetrisInfo_t *game);
+const Frame_t *tetrisUpdateFrame(TetrisInfo_t *game);
+const Frame_t *getTetrisFrame(TetrisInfo_t *game);
+void publishFrame(TetrisInfo_t *game);
+const Frame_t *beginFrameRead(const FrameBuffer_t *frames,
+                              FrameTicket_t *ticket);
+bool endFrameRead(const FrameBuffer_t *frames, FrameTicket_t ticket);
+
 TetrisState_t *getState();
-void setState(TetrisState_t new_state);
-GameInfo_t *getGameInfo();
-TetrisInfo_t *initTetrisInfo();
+void setState(TetrisInfo_t *game, TetrisState_t new_state);
+void markChanged(TetrisInfo_t *game);
 TetrisInfo_t *getTetrisInfo();
-void clearTetrisInfo();
-void clearArray(int **array, int kRows, int kCols);
+void initTetrisInfo(TetrisInfo_t *game);
+void clearTetrisInfo(TetrisInfo_t *game);
+void expandRows(int **cells, const Row_t *rows, int count, int cols);
 
 unsigned long currentTimeMs();
-bool timeToShift();
-void saveHighScore();
+unsigned long realClockMs(void *context);
+unsigned long virtualClockMs(void *context);
+unsigned long gameTimeMs(const TetrisInfo_t *game);
+void setTimeSource(TetrisInfo_t *game, TimeSource_t source, void *context);
+void setRealClock(TetrisInfo_t *game);
+void setVirtualClock(TetrisInfo_t *game, unsigned long start_ms);
+void advanceClock(TetrisInfo_t *game, unsigned long ms);
+bool timeToShift(TetrisInfo_t *game);
+long nextShiftDelayMs(TetrisInfo_t *game);
+void loadHighScore(TetrisInfo_t *game);
+void saveHighScore(TetrisInfo_t *game);
 bool coordinateInField(const int x, const int y);
-bool figureCannotMove(const int x, const int y, const int field_cell);
-void copyTetromino(int dst_fig[kFigRows][kFigCols],
-                   int src_fig[kFigRows][kFigCols]);
-void onStartState(UserAction_t action);
-void onPauseState(UserAction_t action);
-void onGameOverState(UserAction_t action);
-void onMovingState(UserAction_t action);
-void generateNextFigure();
-void handleAttaching();
-void handleTerminateState();
-int getLowestCoordinate();
-bool checkGameOver();
-bool isLineFill(int line);
-void moveGroundDown(int line);
-bool tryMoveFigure(UserAction_t action);
-bool checkNewPosition();
-void addFigureOnField();
-void rotateCurrentFigure();
-void eraseCurrentFigureOnField();
-void dropFigure();
-bool tryRotateFigure();
-void rotateFigureI();
-void rotateFigureJ();
-void rotateFigureT();
-void rotateFigureS();
-void rotateFigureZ();
-void rotateFigureL();
-void clearCurrentFigure();
+bool rowMaskFits(Row_t mask, int x);
+Row_t shiftRowMask(Row_t mask, int x);
+void onStartState(TetrisInfo_t *game, UserAction_t action);
+void onPauseState(TetrisInfo_t *game, UserAction_t action);
+void onGameOverState(TetrisInfo_t *game, UserAction_t action);
+void onMovingState(TetrisInfo_t *game, UserAction_t action);
+void seedRng(Rng_t *rng, uint64_t seed);
+uint32_t nextRandom(Rng_t *rng);
+int randomBelow(Rng_t *rng, int bound);
+void seedTetrisGame(TetrisInfo_t *game, uint64_t seed);
+void setRandomizer(TetrisInfo_t *game, Randomizer_t randomizer);
+Tetromino_t drawFigure(TetrisInfo_t *game);
+int peekNextFigures(TetrisInfo_t *game, Tetromino_t *types, int count);
+Point_t spawnCoordinate(Tetromino_t type);
+void generateNextFigure(TetrisInfo_t *game);
+LinesCleared_t handleAttaching(TetrisInfo_t *game);
+void handleTerminateState(TetrisInfo_t *game);
+int getLowestCoordinate(TetrisInfo_t *game);
+bool checkGameOver(TetrisInfo_t *game);
+LinesCleared_t clearFullLines(Field_t *field, int top, int bottom);
+void lockFigure(Field_t *field, const Orientation_t *shape, int x, int y);
+void updateHeights(Field_t *field);
+void syncFieldMeta(Field_t *field);
+uint64_t cellKey(int line, int column);
+uint64_t rowKey(int line, Row_t row);
+uint64_t rowsKey(const Row_t *rows);
+uint64_t figureKey(const Orientation_t *shape, int x, int y);
+int dropDistance(const Field_t *field, const Orientation_t *shape, int x,
+                 int y);
+int ghostY(const TetrisInfo_t *game);
+int landingHeight(const TetrisInfo_t *game);
+bool tryMoveFigure(TetrisInfo_t *game, UserAction_t action);
+bool checkNewPosition(TetrisInfo_t *game);
+bool figureFits(const Row_t *field, const Orientation_t *shape, int x, int y);
+void composeField(const TetrisInfo_t *game, Row_t *rows);
+void dropFigure(TetrisInfo_t *game);
+bool tryRotateFigure(TetrisInfo_t *game);
+const Orientation_t *figureShape(const Figure_t *fig);
 void setFigure(Figure_t *ptr_fig, Tetromino_t type);
 
 #endif  // BRICK_GAME_TETRIS_H_
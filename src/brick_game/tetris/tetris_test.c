@@ -1,9 +1,20 @@
 #include "tetris.h"
 
 #include <check.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "../../gui/cli/cli.h"
+#include "../../server/server.h"
+#include "../bot/beam.h"
+#include "../bot/bot.h"
 #include "../brick_game.h"
+#include "../profile/profile.h"
+#include "highscore.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "spectate.h"
 
 #ifdef PRINT_TEST
 void printArray(int **array, int rows, int cols) {
@@ -21,8 +32,8 @@ void printArray(int **array, int rows, int cols) {
 // action -> Start
 START_TEST(onStartStateGetStart) {
   // Arrange
-  setState(kStart);
   TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kStart);
   GameInfo_t game_info = {0};
   // Act
   userInput(Start, false);
@@ -38,8 +49,8 @@ END_TEST
 // action -> Terminate
 START_TEST(onStartStateGetTerminate) {
   // Arrange
-  setState(kStart);
   TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kStart);
   GameInfo_t game_info = {0};
   // Act
   userInput(Terminate, false);
@@ -60,14 +71,14 @@ START_TEST(onMovingStateGetLeft) {
   // . . . .[][] . . . .
   // . . . . . . . . . .
   //        ...
-  setState(kMoving);
   TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
   userInput(Start, false);
   setFigure(&game->current.fig, kFigureO);
   game->current.coordinate.x = 3;
   game->current.coordinate.y = 0;
-  tryMoveFigure(Down);
-  GameInfo_t game_info = *getGameInfo();
+  tryMoveFigure(game, Down);
+  GameInfo_t game_info = *getGameInfo(game);
 
 #ifdef PRINT_TEST
   printArray(game_info.field, kRows, kCols);
@@ -106,14 +117,14 @@ START_TEST(onMovingStateGetRight) {
   // . . . .[][] . . . .
   // . . . . . . . . . .
   //        ...
-  setState(kMoving);
   TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
   userInput(Start, false);
   setFigure(&game->current.fig, kFigureO);
   game->current.coordinate.x = 3;
   game->current.coordinate.y = 0;
-  tryMoveFigure(Down);
-  GameInfo_t game_info = *getGameInfo();
+  tryMoveFigure(game, Down);
+  GameInfo_t game_info = *getGameInfo(game);
 
 #ifdef PRINT_TEST
   printArray(game_info.field, kRows, kCols);
@@ -152,14 +163,14 @@ START_TEST(onMovingStateGetDown) {
   // . . . .[][] . . . .
   // . . . . . . . . . .
   //        ...
-  setState(kMoving);
   TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
   userInput(Start, false);
   setFigure(&game->current.fig, kFigureO);
   game->current.coordinate.x = 3;
   game->current.coordinate.y = 0;
-  tryMoveFigure(Down);
-  GameInfo_t game_info = *getGameInfo();
+  tryMoveFigure(game, Down);
+  GameInfo_t game_info = *getGameInfo(game);
 
 #ifdef PRINT_TEST
   printArray(game_info.field, kRows, kCols);
@@ -201,14 +212,14 @@ START_TEST(onMovingStateGetActionFigureTRotation1) {
   // . . . . .[] . . . .
   // . . . . . . . . . .
   //        ...
-  setState(kMoving);
   TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
   userInput(Start, false);
   setFigure(&game->current.fig, kFigureT);
   game->current.coordinate.x = 4;
   game->current.coordinate.y = -1;
-  tryMoveFigure(Down);
-  GameInfo_t game_info = *getGameInfo();
+  tryMoveFigure(game, Down);
+  GameInfo_t game_info = *getGameInfo(game);
 
 #ifdef PRINT_TEST
   printArray(game_info.field, kRows, kCols);
@@ -237,6 +248,1113 @@ START_TEST(onMovingStateGetActionFigureTRotation1) {
 }
 END_TEST
 
+// FSM      -> kMoving
+// action   -> Action x4
+// figure   -> kFigureJ
+START_TEST(onMovingStateGetActionFullTurn) {
+  // Arrange
+  TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
+  setFigure(&game->current.fig, kFigureJ);
+  game->current.coordinate.x = 4;
+  game->current.coordinate.y = 5;
+  tryMoveFigure(game, Down);
+  // Act
+  for (int i = 0; i < kRotations; i++) {
+    ck_assert_int_eq(game->current.fig.rotation, i);
+    userInput(Action, false);
+  }
+  // Assert
+  ck_assert_int_eq(game->current.fig.rotation, 0);
+  ck_assert_ptr_eq(figureShape(&game->current.fig),
+                   &kOrientations[kFigureJ][0]);
+}
+END_TEST
+
+// Row masks, cell lists and bounding boxes of every orientation agree
+START_TEST(orientationTableIsConsistent) {
+  for (int type = 0; type < kTetrominoes; type++) {
+    for (int rotation = 0; rotation < kRotations; rotation++) {
+      const Orientation_t *shape = &kOrientations[type][rotation];
+      Row_t rows[kFigRows] = {0};
+      Box_t box = {kFigCols, kFigRows, -1, -1};
+      for (int k = 0; k < kFigCells; k++) {
+        Point_t cell = shape->cell[k];
+        rows[cell.y] |= (Row_t)(1u << cell.x);
+        box.left = cell.x < box.left ? cell.x : box.left;
+        box.top = cell.y < box.top ? cell.y : box.top;
+        box.right = cell.x > box.right ? cell.x : box.right;
+        box.bottom = cell.y > box.bottom ? cell.y : box.bottom;
+      }
+      for (int i = 0; i < kFigRows; i++) {
+        ck_assert_int_eq(rows[i], shape->row[i]);
+      }
+      ck_assert_int_eq(box.left, shape->box.left);
+      ck_assert_int_eq(box.top, shape->box.top);
+      ck_assert_int_eq(box.right, shape->box.right);
+      ck_assert_int_eq(box.bottom, shape->box.bottom);
+    }
+  }
+}
+END_TEST
+
+// FSM    -> kMoving
+// clock  -> one gravity interval passed
+START_TEST(onMovingStateVirtualClockShift) {
+  // Arrange
+  TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
+  setFigure(&game->current.fig, kFigureO);
+  game->current.coordinate.x = 3;
+  game->current.coordinate.y = 0;
+  tryMoveFigure(game, Down);
+  // Act
+  advanceClock(game, game->update_interval - 1);
+  tetrisUpdateCurrentState(game);
+  int not_yet = game->current.coordinate.y;
+  advanceClock(game, 1);
+  tetrisUpdateCurrentState(game);
+  // Assert
+  ck_assert_int_eq(not_yet, 1);
+  ck_assert_int_eq(game->current.coordinate.y, 2);
+  ck_assert_uint_eq(game->last_tick, gameTimeMs(game));
+}
+END_TEST
+
+// Two contexts do not share any state
+START_TEST(independentGameContexts) {
+  // Arrange
+  TetrisInfo_t *first = createTetrisGame();
+  TetrisInfo_t *second = createTetrisGame();
+  ck_assert_ptr_nonnull(first);
+  ck_assert_ptr_nonnull(second);
+  setVirtualClock(first, 0);
+  setVirtualClock(second, 0);
+  // Act
+  tetrisUserInput(first, Start, false);
+  tetrisUserInput(first, Down, false);
+  GameInfo_t first_info = tetrisUpdateCurrentState(first);
+  GameInfo_t second_info = tetrisUpdateCurrentState(second);
+  // Assert
+  ck_assert_int_eq(first->state, kMoving);
+  ck_assert_int_eq(second->state, kStart);
+  ck_assert_ptr_ne(first_info.field, second_info.field);
+  int first_cells = 0;
+  int second_cells = 0;
+  for (int i = 0; i < kRows; i++) {
+    for (int j = 0; j < kCols; j++) {
+      first_cells += first_info.field[i][j];
+      second_cells += second_info.field[i][j];
+    }
+  }
+  ck_assert_int_eq(first_cells, kFigCells);
+  ck_assert_int_eq(second_cells, 0);
+  destroyTetrisGame(first);
+  destroyTetrisGame(second);
+}
+END_TEST
+
+// The same seed gives the same figures
+START_TEST(seededGamesRepeatFigures) {
+  // Arrange
+  TetrisInfo_t *first = createTetrisGame();
+  TetrisInfo_t *second = createTetrisGame();
+  seedTetrisGame(first, 42);
+  seedTetrisGame(second, 42);
+  // Act
+  tetrisUserInput(first, Start, false);
+  tetrisUserInput(second, Start, false);
+  // Assert
+  for (int i = 0; i < 100; i++) {
+    ck_assert_int_eq(first->current.fig.type, second->current.fig.type);
+    ck_assert_int_eq(first->next.fig.type, second->next.fig.type);
+    generateNextFigure(first);
+    generateNextFigure(second);
+  }
+  destroyTetrisGame(first);
+  destroyTetrisGame(second);
+}
+END_TEST
+
+// Lookahead queue predicts the figures that come out next
+START_TEST(lookaheadQueueMatchesFigures) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  seedTetrisGame(game, 7);
+  tetrisUserInput(game, Start, false);
+  Tetromino_t upcoming[kQueueSize];
+  // Act
+  int count = peekNextFigures(game, upcoming, kQueueSize + 1);
+  // Assert
+  ck_assert_int_eq(count, kQueueSize);
+  ck_assert_int_eq(upcoming[0], game->next.fig.type);
+  for (int i = 0; i < count; i++) {
+    generateNextFigure(game);
+    ck_assert_int_eq(game->current.fig.type, upcoming[i]);
+  }
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// Every 7 figures of the bag randomizer are all seven tetrominoes
+START_TEST(bagRandomizerDealsEveryFigure) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  seedTetrisGame(game, 2024);
+  setRandomizer(game, kRandomizerBag);
+  tetrisUserInput(game, Start, false);
+  // Act & Assert
+  for (int bag = 0; bag < 20; bag++) {
+    int seen = 0;
+    for (int i = 0; i < kTetrominoes; i++) {
+      seen |= 1 << game->current.fig.type;
+      generateNextFigure(game);
+    }
+    ck_assert_int_eq(seen, (1 << kTetrominoes) - 1);
+  }
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// A recorded session replays to the same score and field
+START_TEST(recordedGameReplays) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  setVirtualClock(game, 500);
+  FILE *log = tmpfile();
+  Recorder_t recorder;
+  Rng_t keys;
+  seedRng(&keys, 99);
+  ck_assert(startRecording(&recorder, game, log, 12345));
+  // Act
+  tetrisUserInput(game, Start, false);
+  for (int i = 0; i < 5000 && game->state != kGameOver; i++) {
+    advanceClock(game, 1 + randomBelow(&keys, 400));
+    tetrisUserInput(game, (UserAction_t)(Left + randomBelow(&keys, 5)), false);
+    applyGravity(game);
+  }
+  ck_assert(stopRecording(&recorder, game));
+  rewind(log);
+  ReplayResult_t result;
+  bool replayed = replayLog(log, &result);
+  // Assert
+  ck_assert(replayed);
+  ck_assert_int_eq(result.score, game->score);
+  ck_assert_uint_eq(result.events, recorder.events);
+  ck_assert_int_gt(result.ticks, 0);
+  fclose(log);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// A log cut in the middle is reported as broken
+START_TEST(truncatedLogFails) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  setVirtualClock(game, 0);
+  FILE *log = tmpfile();
+  Recorder_t recorder;
+  startRecording(&recorder, game, log, 1);
+  tetrisUserInput(game, Start, false);
+  advanceClock(game, 1000);
+  applyGravity(game);
+  stopRecording(&recorder, game);
+  // Act
+  long size = ftell(log);
+  FILE *cut = tmpfile();
+  rewind(log);
+  for (long i = 0; i < size / 2; i++) {
+    putc(getc(log), cut);
+  }
+  rewind(cut);
+  ReplayResult_t result;
+  // Assert
+  ck_assert(!replayLog(cut, &result));
+  fclose(log);
+  fclose(cut);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// Vertical I fills the left column of four almost full rows
+START_TEST(handleAttachingClearsTetris) {
+  // Arrange
+  //        ...
+  // . .[] . . . . . . .   row 15
+  //  [][][][][][][][][]   rows 16-19
+  TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
+  game->field.row[15] = 0x4;
+  for (int line = 16; line < kRows; line++) {
+    game->field.row[line] = FULL_ROW & ~1u;
+  }
+  setFigure(&game->current.fig, kFigureI);
+  game->current.fig.rotation = 3;
+  game->current.coordinate.x = -1;
+  game->current.coordinate.y = 15;
+  tryMoveFigure(game, Down);
+  // Act
+  LinesCleared_t cleared = handleAttaching(game);
+  // Assert
+  ck_assert_int_eq(cleared.count, 4);
+  for (int i = 0; i < cleared.count; i++) {
+    ck_assert_int_eq(cleared.rows[i], 16 + i);
+  }
+  ck_assert_int_eq(game->field.row[19], 0x4);
+  for (int line = 0; line < kRows - 1; line++) {
+    ck_assert_int_eq(game->field.row[line], 0);
+  }
+  ck_assert_int_eq(game->score, 1500);
+  ck_assert_int_eq(game->last_cleared.count, 4);
+}
+END_TEST
+
+// Full rows with a kept row between them are removed in one pass
+START_TEST(clearFullLinesKeepsGaps) {
+  // Arrange
+  Field_t field = {0};
+  field.row[14] = 0x1;
+  field.row[16] = FULL_ROW;
+  field.row[17] = 0x3;
+  field.row[18] = FULL_ROW;
+  field.row[19] = 0x7;
+  syncFieldMeta(&field);
+  // Act
+  LinesCleared_t cleared = clearFullLines(&field, 15, 18);
+  // Assert
+  ck_assert_int_eq(cleared.count, 2);
+  ck_assert_int_eq(cleared.rows[0], 16);
+  ck_assert_int_eq(cleared.rows[1], 18);
+  ck_assert_int_eq(field.row[19], 0x7);
+  ck_assert_int_eq(field.row[18], 0x3);
+  ck_assert_int_eq(field.row[16], 0x1);
+  ck_assert_int_eq(field.row[17], 0);
+  ck_assert_int_eq(field.row[15], 0);
+  ck_assert_int_eq(field.fill[18], 2);
+  ck_assert_int_eq(field.height[0], 4);
+  ck_assert_int_eq(field.height[1], 2);
+  ck_assert_int_eq(field.height[2], 1);
+  ck_assert_int_eq(field.height[3], 0);
+}
+END_TEST
+
+// Heights and fill counts follow locks and clears of a whole game
+START_TEST(fieldMetaFollowsGame) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  seedTetrisGame(game, 5);
+  setVirtualClock(game, 0);
+  Rng_t keys;
+  seedRng(&keys, 5);
+  tetrisUserInput(game, Start, false);
+  // Act & Assert
+  for (int i = 0; i < 3000 && game->state == kMoving; i++) {
+    tetrisUserInput(game, (UserAction_t)(Left + randomBelow(&keys, 5)), false);
+    advanceClock(game, game->update_interval);
+    applyGravity(game);
+    Field_t expected = game->field;
+    syncFieldMeta(&expected);
+    ck_assert_mem_eq(game->field.height, expected.height,
+                     sizeof(expected.height));
+    ck_assert_mem_eq(game->field.fill, expected.fill, sizeof(expected.fill));
+  }
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// Hard drop under an overhang stops on the first cell below the figure
+START_TEST(dropFigureUnderOverhang) {
+  // Arrange
+  // [][][][] . . . . . .   row 10
+  //  . . . . . . . . . .
+  //        ...
+  //  . [] . . . . . . . .   row 18
+  //  . . . . . . . . . .   row 19
+  TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
+  game->field.row[10] = 0xF;
+  game->field.row[18] = 0x2;
+  syncFieldMeta(&game->field);
+  setFigure(&game->current.fig, kFigureO);
+  game->current.coordinate.x = -1;
+  game->current.coordinate.y = 12;
+  tryMoveFigure(game, Down);
+  // Act
+  int overhang_ghost = ghostY(game);
+  userInput(Down, false);
+  // Assert
+  ck_assert_int_lt(
+      dropDistance(&game->field, figureShape(&game->current.fig), -1, 13), 0);
+  ck_assert_int_eq(overhang_ghost, 16);
+  ck_assert_int_eq(game->current.coordinate.y, 16);
+  ck_assert_int_eq(landingHeight(game), 2);
+}
+END_TEST
+
+// Moves change only the figure, the frame draws it over the locked field
+START_TEST(movesKeepLockedField) {
+  // Arrange
+  TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kMoving);
+  game->field.row[19] = 0x1;
+  syncFieldMeta(&game->field);
+  setFigure(&game->current.fig, kFigureO);
+  game->current.coordinate.x = 3;
+  game->current.coordinate.y = 5;
+  Field_t locked = game->field;
+  // Act
+  userInput(Left, false);
+  userInput(Action, false);
+  userInput(Down, false);
+  GameInfo_t game_info = *getGameInfo(game);
+  // Assert
+  ck_assert_mem_eq(&game->field, &locked, sizeof(locked));
+  ck_assert_int_eq(game_info.field[19][0], 1);
+  ck_assert_int_eq(game_info.field[18][3], 1);
+  ck_assert_int_eq(game_info.field[19][3], 1);
+  ck_assert_int_eq(game_info.field[18][5], 0);
+}
+END_TEST
+
+// Percentiles come back within the precision of one bucket
+START_TEST(histogramPercentiles) {
+  // Arrange
+  Histogram_t histogram = {0};
+  // Act
+  for (uint64_t ns = 1; ns <= 1000000; ns++) {
+    histogramAdd(&histogram, ns);
+  }
+  histogramAdd(&histogram, kHistogramMaxNs * 2);
+  // Assert
+  ck_assert_int_eq(histogramIndex(63), 63);
+  ck_assert_int_eq(histogramValue(histogramIndex(100)) >= 100, true);
+  ck_assert_int_eq(histogramIndex(kHistogramMaxNs * 2), kHistogramBuckets - 1);
+  uint64_t median = histogramPercentile(&histogram, 50);
+  ck_assert_int_ge(median, 500000);
+  ck_assert_int_le(median, 500000 + 500000 / kHistogramSubCount);
+  ck_assert_int_eq(histogramPercentile(&histogram, 100), kHistogramMaxNs - 1);
+}
+END_TEST
+
+static void tempScoresPath(char *path) {
+  strcpy(path, "/tmp/brick_scores_XXXXXX");
+  close(mkstemp(path));
+  unlink(path);
+}
+
+// Best first, equal scores keep the older entry ahead
+START_TEST(leaderboardKeepsBestScores) {
+  // Arrange
+  char path[64];
+  tempScoresPath(path);
+  ScoreEntry_t entries[12];
+  for (int i = 0; i < 12; i++) {
+    entries[i].score = (uint32_t)(i + 1) * 100;
+    entries[i].time = (uint64_t)i;
+  }
+  ScoreEntry_t tie = {.score = 1200, .time = 99};
+  // Act
+  bool first = submitScores(path, entries, 6);
+  bool second = submitScores(path, &entries[6], 6);
+  bool third = submitScores(path, &tie, 1);
+  Leaderboard_t board;
+  bool read = readLeaderboard(path, &board);
+  // Assert
+  ck_assert(first && second && third && read);
+  ck_assert_int_eq(board.count, kLeaderboardSize);
+  ck_assert_int_eq(board.entry[0].score, 1200);
+  ck_assert_int_eq(board.entry[0].time, 11);
+  ck_assert_int_eq(board.entry[1].time, 99);
+  ck_assert_int_eq(board.entry[kLeaderboardSize - 1].score, 400);
+  unlink(path);
+  strcat(path, ".lock");
+  unlink(path);
+}
+END_TEST
+
+// A damaged file reads as an empty board
+START_TEST(damagedLeaderboardIsEmpty) {
+  // Arrange
+  char path[64];
+  tempScoresPath(path);
+  Leaderboard_t board = {.count = 1, .entry = {{.score = 500, .time = 1}}};
+  writeLeaderboard(path, &board);
+  FILE *file = fopen(path, "r+b");
+  fseek(file, kScoresHeaderBytes, SEEK_SET);
+  fputc(0x7F, file);
+  fclose(file);
+  // Act
+  bool read = readLeaderboard(path, &board);
+  // Assert
+  ck_assert(!read);
+  ck_assert_int_eq(board.count, 0);
+  unlink(path);
+}
+END_TEST
+
+// The writer thread stores a finished game once
+START_TEST(gameScorePostedOnce) {
+  // Arrange
+  char path[64];
+  tempScoresPath(path);
+  setScoresPath(path);
+  TetrisInfo_t *game = createTetrisGame();
+  game->persistent = true;
+  game->score = 700;
+  // Act
+  saveHighScore(game);
+  saveHighScore(game);
+  flushScores();
+  Leaderboard_t board;
+  readLeaderboard(path, &board);
+  // Assert
+  ck_assert_int_eq(board.count, 1);
+  ck_assert_int_eq(board.entry[0].score, 700);
+  destroyTetrisGame(game);
+  unlink(path);
+  strcat(path, ".lock");
+  unlink(path);
+}
+END_TEST
+
+// A restored copy plays on exactly like the game it was taken from
+START_TEST(restoredGameContinues) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  TetrisInfo_t *copy = createTetrisGame();
+  seedTetrisGame(game, 21);
+  setRandomizer(game, kRandomizerBag);
+  setVirtualClock(game, 0);
+  setVirtualClock(copy, 5000);
+  static const UserAction_t kKeys[] = {Left, Right, Action, Left, Up};
+  Rng_t keys;
+  seedRng(&keys, 21);
+  tetrisUserInput(game, Start, false);
+  for (int i = 0; i < 100 && game->state == kMoving; i++) {
+    tetrisUserInput(game, kKeys[randomBelow(&keys, 5)], false);
+    advanceClock(game, game->update_interval);
+    applyGravity(game);
+  }
+  advanceClock(game, 300);
+  // Act
+  Snapshot_t snapshot = snapshotGame(game);
+  bool restored = restoreGame(copy, &snapshot);
+  Rng_t copy_keys = keys;
+  for (int i = 0; i < 400 && game->state == kMoving; i++) {
+    tetrisUserInput(game, kKeys[randomBelow(&keys, 5)], false);
+    tetrisUserInput(copy, kKeys[randomBelow(&copy_keys, 5)], false);
+    advanceClock(game, 350);
+    advanceClock(copy, 350);
+    applyGravity(game);
+    applyGravity(copy);
+  }
+  // Assert
+  ck_assert(restored);
+  ck_assert_int_le(sizeof(Snapshot_t), 96);
+  ck_assert_int_eq(copy->score, game->score);
+  ck_assert_int_eq(copy->pieces, game->pieces);
+  ck_assert_int_eq(copy->state, game->state);
+  ck_assert_mem_eq(&copy->field, &game->field, sizeof(Field_t));
+  Snapshot_t game_end = snapshotGame(game);
+  Snapshot_t copy_end = snapshotGame(copy);
+  ck_assert_mem_eq(&copy_end, &game_end, sizeof(Snapshot_t));
+  destroyTetrisGame(copy);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// Out of range figures leave the game untouched
+START_TEST(badSnapshotRejected) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  Snapshot_t snapshot = snapshotGame(game);
+  snapshot.figure = 7;
+  unsigned long version = game->version;
+  // Act
+  bool restored = restoreGame(game, &snapshot);
+  // Assert
+  ck_assert(!restored);
+  ck_assert_int_eq(game->version, version);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// A moving figure inside the rows or a level past the cap is rejected
+START_TEST(overlappingSnapshotRejected) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  seedTetrisGame(game, 3);
+  tetrisUserInput(game, Start, false);
+  Snapshot_t inside = snapshotGame(game);
+  inside.y = kRows - 2;
+  inside.row[kRows - 1] = FULL_ROW >> 1;
+  Snapshot_t fast = snapshotGame(game);
+  fast.level = kMaxLevel + 1;
+  unsigned long version = game->version;
+  // Act
+  bool restored_inside = restoreGame(game, &inside);
+  bool restored_fast = restoreGame(game, &fast);
+  // Assert
+  ck_assert(!restored_inside);
+#ifndef NO_LIMITS
+  ck_assert(!restored_fast);
+#endif  // NO_LIMITS
+  ck_assert_int_eq(game->version, version);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// A frame is published once per change and matches the game
+START_TEST(frameFollowsVersion) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  seedTetrisGame(game, 8);
+  setVirtualClock(game, 0);
+  tetrisUserInput(game, Start, false);
+  tetrisUserInput(game, Left, false);
+  // Act
+  const Frame_t *first = getTetrisFrame(game);
+  unsigned long published = game->frames.published;
+  const Frame_t *again = getTetrisFrame(game);
+  // Assert
+  ck_assert_ptr_eq(first, again);
+  ck_assert_int_eq(game->frames.published, published);
+  ck_assert_int_eq(first->version, game->version);
+  ck_assert(first->running);
+  Row_t rows[kRows];
+  composeField(game, rows);
+  for (int i = 0; i < kRows; i++) {
+    ck_assert_int_eq(first->field[i], rows[i]);
+  }
+  tetrisUserInput(game, Right, false);
+  ck_assert_ptr_ne(getTetrisFrame(game), first);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// A reader notices only the publishes that reuse the frame it is reading
+START_TEST(frameReadDetectsOverwrite) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  getTetrisFrame(game);
+  FrameTicket_t ticket;
+  // Act
+  const Frame_t *frame = beginFrameRead(&game->frames, &ticket);
+  markChanged(game);
+  publishFrame(game);
+  bool after_one = endFrameRead(&game->frames, ticket);
+  markChanged(game);
+  publishFrame(game);
+  bool after_two = endFrameRead(&game->frames, ticket);
+  // Assert
+  ck_assert_ptr_nonnull(frame);
+  ck_assert(after_one);
+  ck_assert(!after_two);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// A frame of brickd decodes to the frame the server encoded
+START_TEST(frameMessageRoundTrips) {
+  // Arrange
+  Frame_t frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.version = 0x0123456789ABCDEFul;
+  frame.score = 123456;
+  frame.high_score = 654321;
+  frame.level = 7;
+  frame.speed = 9;
+  frame.pause = 1;
+  frame.running = true;
+  for (int i = 0; i < FRAME_NEXT; i++) {
+    frame.next[i] = (uint32_t)(0xF - 5 * i) & 0xF;
+  }
+  for (int i = 0; i < FRAME_ROWS; i++) {
+    frame.field[i] = (BoardRow_t)((0x2D5u * (i + 1)) & FULL_ROW);
+  }
+  uint8_t message[kFrameMessageBytes];
+  Frame_t decoded;
+  memset(&decoded, 0xA5, sizeof(decoded));
+  // Act
+  encodeFrame(&frame, message);
+  decodeFrame(message, &decoded);
+  // Assert
+  ck_assert_uint_eq(decoded.version, frame.version);
+  ck_assert_int_eq(decoded.score, frame.score);
+  ck_assert_int_eq(decoded.high_score, frame.high_score);
+  ck_assert_int_eq(decoded.level, frame.level);
+  ck_assert_int_eq(decoded.speed, frame.speed);
+  ck_assert_int_eq(decoded.pause, frame.pause);
+  ck_assert_int_eq(decoded.running, frame.running);
+  ck_assert_mem_eq(decoded.next, frame.next, sizeof(frame.next));
+  ck_assert_mem_eq(decoded.field, frame.field, sizeof(frame.field));
+}
+END_TEST
+
+typedef struct {
+  ServerConfig_t config;
+  bool ok;
+} ServerRun_t;
+
+static void *serveInThread(void *arg) {
+  ServerRun_t *run = arg;
+  run->ok = runServer(&run->config);
+  return NULL;
+}
+
+// Reads one frame message, false once the server closed the connection
+static bool receiveFrame(int fd, Frame_t *frame) {
+  uint8_t message[kFrameMessageBytes];
+  size_t length = 0;
+  ssize_t got = 1;
+  while (length < sizeof(message) && got > 0) {
+    got = recv(fd, message + length, sizeof(message) - length, 0);
+    length += got > 0 ? (size_t)got : 0;
+  }
+  if (length == sizeof(message)) {
+    decodeFrame(message, frame);
+  }
+  return length == sizeof(message);
+}
+
+// A client of brickd on a real socket gets the frame of its new game, and
+// the last frame of a Terminate before the server hangs up
+START_TEST(serverSessionSendsFrames) {
+  // Arrange
+  ServerRun_t run = {.config = {.workers = 2, .max_sessions = 4}};
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/brickd_test.%d.sock", (int)getpid());
+  run.config.path = path;
+  pthread_t server;
+  ck_assert_int_eq(pthread_create(&server, NULL, serveInThread, &run), 0);
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  strcpy(address.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  bool connected = false;
+  for (int i = 0; i < 500 && !connected; i++) {
+    connected =
+        connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0;
+    if (!connected) {
+      nanosleep(&(struct timespec){0, 2000000}, NULL);
+    }
+  }
+  Frame_t first;
+  Frame_t last;
+  // Act
+  bool got_first = connected && receiveFrame(fd, &first);
+  uint8_t inputs[] = {Start, Terminate};
+  bool sent = send(fd, inputs, sizeof(inputs), MSG_NOSIGNAL) ==
+              (ssize_t)sizeof(inputs);
+  int frames = 0;
+  last = first;
+  while (frames < 1000 && receiveFrame(fd, &last)) {
+    frames++;
+  }
+  close(fd);
+  pthread_kill(server, SIGTERM);
+  pthread_join(server, NULL);
+  // Assert
+  ck_assert(connected);
+  ck_assert(got_first);
+  ck_assert(first.running);
+  ck_assert(sent);
+  ck_assert_int_gt(frames, 0);
+  ck_assert_int_lt(frames, 1000);
+  ck_assert(!last.running);
+  ck_assert_uint_gt(last.version, first.version);
+  ck_assert(run.ok);
+  ck_assert_int_ne(access(path, F_OK), 0);
+}
+END_TEST
+
+static void spectateName(char *name, const char *test) {
+  snprintf(name, kSpectateNameSize - 16, "%s.%d", test, (int)getpid());
+}
+
+START_TEST(spectatorFollowsBroadcast) {
+  // Arrange
+  char name[kSpectateNameSize];
+  spectateName(name, "follow");
+  TetrisInfo_t *game = createTetrisGame();
+  seedTetrisGame(game, 9);
+  setVirtualClock(game, 0);
+  Broadcaster_t broadcaster;
+  Spectator_t spectator;
+  ck_assert(startBroadcast(&broadcaster, game, name));
+  ck_assert(attachSpectator(&spectator, name));
+  const UserAction_t keys[] = {Start, Left, Action, Down, Right, Up};
+  // Act
+  for (int i = 0; i < 60; i++) {
+    tetrisUserInput(game, keys[i % 6], false);
+    getTetrisFrame(game);
+    ck_assert_int_ne(pollSpectator(&spectator), kSpectateLost);
+  }
+  // Assert
+  const Frame_t *frame = getTetrisFrame(game);
+  ck_assert_int_eq(spectator.frame.version, frame->version);
+  ck_assert_int_eq(spectator.frame.score, frame->score);
+  ck_assert_int_eq(spectator.frame.running, frame->running);
+  for (int i = 0; i < FRAME_ROWS; i++) {
+    ck_assert_int_eq(spectator.frame.field[i], frame->field[i]);
+  }
+  ck_assert_int_eq(spectator.resyncs, 0);
+  detachSpectator(&spectator);
+  stopBroadcast(&broadcaster, game);
+  ck_assert(!attachSpectator(&spectator, name));
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// A spectator that misses more than the ring holds starts at a keyframe
+START_TEST(spectatorResyncsFromKeyframe) {
+  // Arrange
+  char name[kSpectateNameSize];
+  spectateName(name, "resync");
+  TetrisInfo_t *game = createTetrisGame();
+  Broadcaster_t broadcaster;
+  Spectator_t spectator;
+  ck_assert(startBroadcast(&broadcaster, game, name));
+  ck_assert(attachSpectator(&spectator, name));
+  ck_assert_int_eq(pollSpectator(&spectator), kSpectateFrame);
+  // Act
+  for (int i = 0; i < kSpectateSlots + kKeyframeInterval / 2; i++) {
+    game->field.row[i % kRows] ^= 1;
+    markChanged(game);
+    getTetrisFrame(game);
+  }
+  SpectateStatus_t status = pollSpectator(&spectator);
+  // Assert
+  ck_assert_int_eq(status, kSpectateFrame);
+  ck_assert_int_eq(spectator.resyncs, 1);
+  const Frame_t *frame = getTetrisFrame(game);
+  ck_assert_int_eq(spectator.frame.version, frame->version);
+  for (int i = 0; i < FRAME_ROWS; i++) {
+    ck_assert_int_eq(spectator.frame.field[i], frame->field[i]);
+  }
+  detachSpectator(&spectator);
+  stopBroadcast(&broadcaster, game);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+START_TEST(boardFeaturesCountCells) {
+  // Arrange
+  //  . . . . . . . . . .   rows 0-17
+  // [][] . . . . . . . .   row 18
+  // [] .[][][][][][][] .   row 19
+  Row_t rows[kRows] = {0};
+  rows[18] = 0x3;
+  rows[19] = 0x1FD;
+  // Act
+  BoardFeatures_t features = boardFeatures(rows, 2);
+  // Assert
+  ck_assert_int_eq(features.height, 11);
+  ck_assert_int_eq(features.holes, 1);
+  ck_assert_int_eq(features.bumpiness, 2);
+  ck_assert_int_eq(features.wells, 1);
+  ck_assert_int_eq(features.lines, 2);
+}
+END_TEST
+
+// Plays a plan on the virtual clock, a fall waits for one gravity step
+static void playPlan(TetrisInfo_t *game, const MoveCode_t *steps, int count) {
+  for (int i = 0; i < count; i++) {
+    UserAction_t action;
+    if (moveInput(steps[i], &action)) {
+      tetrisUserInput(game, action, false);
+    } else {
+      advanceClock(game, game->update_interval);
+      applyGravity(game);
+    }
+  }
+}
+
+// The plan of the bot drops an I into the only gap of four rows
+START_TEST(botPlanClearsTetris) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  setVirtualClock(game, 0);
+  tetrisUserInput(game, Start, false);
+  for (int line = kRows - 4; line < kRows; line++) {
+    game->field.row[line] = FULL_ROW & ~1u;
+  }
+  syncFieldMeta(&game->field);
+  setFigure(&game->current.fig, kFigureI);
+  game->current.coordinate.x = 3;
+  game->current.coordinate.y = -2;
+  static BotScratch_t scratch;
+  MoveCode_t steps[kBotMaxPlan];
+  // Act
+  int count = botPlan(game, &kBotWeights, &scratch, steps);
+  playPlan(game, steps, count);
+  advanceClock(game, game->update_interval);
+  applyGravity(game);
+  // Assert
+  ck_assert_int_le(count, kBotMaxPlan);
+  ck_assert_int_eq(steps[count - 1], kMoveDrop);
+  ck_assert_int_eq(game->last_cleared.count, 4);
+  for (int line = 0; line < kRows; line++) {
+    ck_assert_int_eq(game->field.row[line], 0);
+  }
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// Field with a roof over the left columns, the O spawns at its usual place
+static TetrisInfo_t *createRoofedGame(void) {
+  TetrisInfo_t *game = createTetrisGame();
+  setVirtualClock(game, 0);
+  tetrisUserInput(game, Start, false);
+  game->field.row[kRows - 3] = 0xF;
+  syncFieldMeta(&game->field);
+  setFigure(&game->current.fig, kFigureO);
+  game->current.coordinate.x = kCols / 2 - 2;
+  game->current.coordinate.y = -2;
+  return game;
+}
+
+// The O can only reach the corner under the roof by a drop and a slide
+START_TEST(generateMovesTucksUnderOverhang) {
+  // Arrange
+  //  . . . . . . . . . .
+  //        ...
+  // [][][][] . . . . . .   row 17
+  //  . . . . . . . . . .   row 18
+  //  . . . . . . . . . .   row 19
+  TetrisInfo_t *game = createRoofedGame();
+  const Orientation_t *shapes = kOrientations[kFigureO];
+  static MoveGen_t gen;
+  static MoveList_t moves;
+  // Act
+  int count = generateGameMoves(&gen, game, &moves);
+  // Assert
+  int tucks = 0;
+  for (int i = 0; i < count; i++) {
+    const Move_t *move = &moves.move[i];
+    const Orientation_t *shape = &shapes[move->rotation];
+    if (move->x + shape->box.left == 0 &&
+        move->y + shape->box.bottom == kRows - 1) {
+      tucks++;
+      MoveCode_t steps[kMovePathMax];
+      ck_assert_int_eq(moveSteps(move, steps), 5);
+      ck_assert_int_eq(steps[0], kMoveDrop);
+      ck_assert_int_eq(steps[4], kMoveLeft);
+    }
+  }
+  // Rotations of the O are one placement: nine on the floor, four on top
+  ck_assert_int_eq(tucks, 1);
+  ck_assert_int_eq(count, kCols - 1 + 4);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// Every path lands the figure where its move says under tetrisUserInput()
+START_TEST(generateMovesReplayOnEngine) {
+  // Arrange
+  TetrisInfo_t *game = createRoofedGame();
+  game->field.row[kRows - 1] = 0x3F0;
+  game->field.row[kRows - 6] = 0x060;
+  syncFieldMeta(&game->field);
+  setFigure(&game->current.fig, kFigureT);
+  static MoveGen_t gen;
+  static MoveList_t moves;
+  // Act
+  int count = generateGameMoves(&gen, game, &moves);
+  // Assert
+  ck_assert_int_gt(count, 0);
+  for (int i = 0; i < count; i++) {
+    TetrisInfo_t *replay = createRoofedGame();
+    memcpy(replay->field.row, game->field.row, sizeof(game->field.row));
+    syncFieldMeta(&replay->field);
+    setFigure(&replay->current.fig, kFigureT);
+    MoveCode_t steps[kMovePathMax];
+    int length = moveSteps(&moves.move[i], steps);
+    playPlan(replay, steps, length);
+    ck_assert_int_eq(replay->current.fig.rotation, moves.move[i].rotation);
+    ck_assert_int_eq(replay->current.coordinate.x, moves.move[i].x);
+    ck_assert_int_eq(replay->current.coordinate.y, moves.move[i].y);
+    ck_assert_int_eq(ghostY(replay), moves.move[i].y);
+    destroyTetrisGame(replay);
+  }
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// The O falls past a ledge and slides into a pocket no drop reaches
+START_TEST(generateMovesSlidesWhileFalling) {
+  // Arrange
+  // [][][][] . . . . . .   roof
+  //  . . . . . . . . . .   pocket
+  //  . . . . . . . . . .   pocket
+  // [][][][] . . . . . .   down to the floor
+  TetrisInfo_t *game = createRoofedGame();
+  game->field.row[kRows - 3] = 0;
+  game->field.row[kRows - 11] = 0xF;
+  for (int line = kRows - 8; line < kRows; line++) {
+    game->field.row[line] = 0xF;
+  }
+  syncFieldMeta(&game->field);
+  static MoveGen_t gen;
+  static MoveList_t moves;
+  // Act
+  int count = generateGameMoves(&gen, game, &moves);
+  // Assert
+  const Move_t *pocket = NULL;
+  for (int i = 0; i < count; i++) {
+    const Move_t *move = &moves.move[i];
+    const Orientation_t *shape = &kOrientations[kFigureO][move->rotation];
+    if (move->x + shape->box.left == 0 &&
+        move->y + shape->box.bottom == kRows - 9) {
+      pocket = move;
+    }
+  }
+  ck_assert_ptr_nonnull(pocket);
+  MoveCode_t steps[kMovePathMax];
+  int length = moveSteps(pocket, steps);
+  int falls = 0;
+  for (int i = 0; i < length; i++) {
+    falls += steps[i] == kMoveFall;
+  }
+  ck_assert_int_gt(falls, 0);
+  playPlan(game, steps, length);
+  advanceClock(game, game->update_interval);
+  applyGravity(game);
+  ck_assert_int_eq(game->field.row[kRows - 10], 0x3);
+  ck_assert_int_eq(game->field.row[kRows - 9], 0x3);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// Locks and line clears keep the hash of the rows without a full rehash
+START_TEST(fieldHashFollowsLocks) {
+  // Arrange
+  TetrisInfo_t *game = createTetrisGame();
+  seedTetrisGame(game, 7);
+  setVirtualClock(game, 0);
+  tetrisUserInput(game, Start, false);
+  unsigned long lines = 0;
+  static BotScratch_t scratch;
+  // Act
+  for (int piece = 0; piece < 200 && game->state == kMoving; piece++) {
+    MoveCode_t steps[kBotMaxPlan];
+    int count = botPlan(game, &kBotWeights, &scratch, steps);
+    playPlan(game, steps, count);
+    advanceClock(game, game->update_interval);
+    applyGravity(game);
+    lines += (unsigned long)game->last_cleared.count;
+    // Assert
+    ck_assert_uint_eq(game->field.hash, rowsKey(game->field.row));
+  }
+  ck_assert_uint_gt(lines, 0);
+  ck_assert_uint_ne(cellKey(0, 0), cellKey(0, 1));
+  clearTetrisInfo(game);
+  TetrisInfo_t *fresh = createTetrisGame();
+  const Row_t empty[kRows] = {0};
+  ck_assert_uint_ne(rowsKey(empty), 0);
+  ck_assert_uint_eq(game->field.hash, rowsKey(empty));
+  ck_assert_uint_eq(fresh->field.hash, rowsKey(empty));
+  destroyTetrisGame(fresh);
+  destroyTetrisGame(game);
+}
+END_TEST
+
+// A probe never returns the halves of two different stores
+START_TEST(transpositionTableRejectsTornEntries) {
+  // Arrange
+  TTable_t table;
+  ck_assert(createTTable(&table, 1 << 16));
+  uint64_t key = rowsKey((const Row_t[kRows]){[kRows - 1] = 0x3});
+  uint64_t data = 0;
+  // Act
+  storeTTable(&table, key, 42);
+  bool found = probeTTable(&table, key, &data);
+  bool other = probeTTable(&table, key ^ 1, &data);
+  TTableEntry_t *entry = &table.bucket[key & table.mask].entry[0];
+  for (int way = 0; way < kTTableWays; way++) {
+    TTableEntry_t *candidate = &table.bucket[key & table.mask].entry[way];
+    entry = atomic_load(&candidate->data) == 42 ? candidate : entry;
+  }
+  atomic_store(&entry->data, 43);
+  bool torn = probeTTable(&table, key, &data);
+  // Assert
+  ck_assert(found);
+  ck_assert(!other);
+  ck_assert(!torn);
+  ck_assert_uint_eq(data, 42);
+  destroyTTable(&table);
+}
+END_TEST
+
+// Placement of the falling figure the planner picks on a fresh seeded game
+static Placement_t beamOnSeededGame(const BeamConfig_t *config) {
+  TetrisInfo_t *game = createTetrisGame();
+  seedTetrisGame(game, 11);
+  setVirtualClock(game, 0);
+  tetrisUserInput(game, Start, false);
+  for (int line = kRows - 4; line < kRows; line++) {
+    game->field.row[line] = FULL_ROW & ~(Row_t)0x3;
+  }
+  syncFieldMeta(&game->field);
+  Beam_t *beam = createBeam(config, &kBotWeights);
+  ck_assert_ptr_nonnull(beam);
+  Placement_t best = {0};
+  ck_assert(beamPlacement(beam, game, &best));
+  destroyBeam(beam);
+  destroyTetrisGame(game);
+  return best;
+}
+
+// Worker threads split the plies, the pick stays the same
+START_TEST(beamPlacementIgnoresThreads) {
+  // Arrange
+  BeamConfig_t config = kBeamDefaults;
+  config.budget_ms = 0;
+  config.depth = 4;
+  BeamConfig_t threaded = config;
+  threaded.threads = 3;
+  // Act
+  Placement_t alone = beamOnSeededGame(&config);
+  Placement_t shared = beamOnSeededGame(&threaded);
+  // Assert
+  ck_assert_int_eq(alone.move.rotation, shared.move.rotation);
+  ck_assert_int_eq(alone.move.x, shared.move.x);
+  ck_assert_int_eq(alone.move.y, shared.move.y);
+  ck_assert(alone.score == shared.score);
+}
+END_TEST
+
+// An O fills the two open columns, the preview adds plies
+START_TEST(beamPlanClearsLines) {
+  // Arrange
+  BeamConfig_t config = kBeamDefaults;
+  config.budget_ms = 0;
+  TetrisInfo_t *game = createTetrisGame();
+  // Some previews make the beam keep the gap for later, this one does not
+  seedTetrisGame(game, 1);
+  setVirtualClock(game, 0);
+  tetrisUserInput(game, Start, false);
+  for (int line = kRows - 4; line < kRows; line++) {
+    game->field.row[line] = FULL_ROW & ~(Row_t)0x3;
+  }
+  syncFieldMeta(&game->field);
+  setFigure(&game->current.fig, kFigureO);
+  game->current.coordinate = spawnCoordinate(kFigureO);
+  Beam_t *beam = createBeam(&config, &kBotWeights);
+  MoveCode_t steps[kBotMaxPlan];
+  // Act
+  int count = beamPlan(beam, game, steps);
+  playPlan(game, steps, count);
+  advanceClock(game, game->update_interval);
+  applyGravity(game);
+  // Assert
+  ck_assert_int_eq(game->last_cleared.count, 2);
+  ck_assert_uint_eq(game->field.hash, rowsKey(game->field.row));
+  ck_assert_uint_gt(beam->plies, 1);
+  destroyBeam(beam);
+  destroyTetrisGame(game);
+}
+END_TEST
+
 // FSM    -> kMoving
 // action -> Pause
 
@@ -253,8 +1371,8 @@ END_TEST
 // action -> Start
 START_TEST(onGameOverStateGetStart) {
   // Arrange
-  setState(kGameOver);
   TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kGameOver);
   GameInfo_t game_info = {0}; // положить что-нибудь?
 
   // Act
@@ -274,8 +1392,8 @@ END_TEST
 // action -> Terminate
 START_TEST(onGameOverStateGetTerminate) {
   // Arrange
-  setState(kGameOver);
   TetrisInfo_t *game = getTetrisInfo();
+  setState(game, kGameOver);
   GameInfo_t game_info = {0};
   // Act
   userInput(Terminate, false);
@@ -300,6 +1418,42 @@ Suite *create_suite_tetris(void) {
   tcase_add_test(tc_core, onMovingStateGetRight);
   tcase_add_test(tc_core, onMovingStateGetDown);
   tcase_add_test(tc_core, onMovingStateGetActionFigureTRotation1);
+  tcase_add_test(tc_core, onMovingStateGetActionFullTurn);
+  tcase_add_test(tc_core, orientationTableIsConsistent);
+  tcase_add_test(tc_core, onMovingStateVirtualClockShift);
+  tcase_add_test(tc_core, independentGameContexts);
+  tcase_add_test(tc_core, seededGamesRepeatFigures);
+  tcase_add_test(tc_core, lookaheadQueueMatchesFigures);
+  tcase_add_test(tc_core, bagRandomizerDealsEveryFigure);
+  tcase_add_test(tc_core, recordedGameReplays);
+  tcase_add_test(tc_core, truncatedLogFails);
+  tcase_add_test(tc_core, handleAttachingClearsTetris);
+  tcase_add_test(tc_core, clearFullLinesKeepsGaps);
+  tcase_add_test(tc_core, fieldMetaFollowsGame);
+  tcase_add_test(tc_core, dropFigureUnderOverhang);
+  tcase_add_test(tc_core, movesKeepLockedField);
+  tcase_add_test(tc_core, histogramPercentiles);
+  tcase_add_test(tc_core, leaderboardKeepsBestScores);
+  tcase_add_test(tc_core, damagedLeaderboardIsEmpty);
+  tcase_add_test(tc_core, gameScorePostedOnce);
+  tcase_add_test(tc_core, restoredGameContinues);
+  tcase_add_test(tc_core, badSnapshotRejected);
+  tcase_add_test(tc_core, overlappingSnapshotRejected);
+  tcase_add_test(tc_core, frameFollowsVersion);
+  tcase_add_test(tc_core, frameReadDetectsOverwrite);
+  tcase_add_test(tc_core, frameMessageRoundTrips);
+  tcase_add_test(tc_core, serverSessionSendsFrames);
+  tcase_add_test(tc_core, spectatorFollowsBroadcast);
+  tcase_add_test(tc_core, spectatorResyncsFromKeyframe);
+  tcase_add_test(tc_core, boardFeaturesCountCells);
+  tcase_add_test(tc_core, botPlanClearsTetris);
+  tcase_add_test(tc_core, generateMovesTucksUnderOverhang);
+  tcase_add_test(tc_core, generateMovesReplayOnEngine);
+  tcase_add_test(tc_core, generateMovesSlidesWhileFalling);
+  tcase_add_test(tc_core, fieldHashFollowsLocks);
+  tcase_add_test(tc_core, transpositionTableRejectsTornEntries);
+  tcase_add_test(tc_core, beamPlacementIgnoresThreads);
+  tcase_add_test(tc_core, beamPlanClearsLines);
 
   // Pause state tests
 
@@ -313,11 +1467,10 @@ Suite *create_suite_tetris(void) {
 }
 
 int main(void) {
-  // Установлен большой интервал обновления, чтобы
+  // Виртуальные часы стоят на месте, чтобы
   // исключить сдвиг фигур по таймеру
   // мешающий при проверке перемещений
-  TetrisInfo_t *game = getTetrisInfo();
-  game->update_interval = 9999999999UL;
+  setVirtualClock(getTetrisInfo(), 0);
 
   int failed_counter, exit_status;
   Suite *suite = create_suite_tetris();
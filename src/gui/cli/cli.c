@@ -1,30 +1,74 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "cli.h"
 
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "../../brick_game/profile/profile.h"
+
 void initNcurses() {
   initscr();
   cbreak();
   keypad(stdscr, true);
   noecho();
   curs_set(0);
-  timeout(100);
+  // getch() never blocks, gameLoop() sleeps in waitForInput() instead
+  nodelay(stdscr, true);
 }
 
 void gameLoop() {
   UserAction_t action;
-  GameInfo_t info;
-  bool run_game;
+  bool run_game = true;
+  unsigned long shown_version = 0;
+  bool shown = false;
   do {
-    if (getAction(&action)) {
-      userInput(action, false);
+    PROFILE_START(frame);
+    const Frame_t *frame = updateFrame();
+    // Nothing to draw while the game stands still
+    if (!shown || frame->version != shown_version) {
+      shown_version = frame->version;
+      shown = true;
+      run_game = showState(frame);
+      refresh();
+      PROFILE_RENDERED();
+      PROFILE_SAMPLE(frame, kHistogramFrameTime);
+    }
+    if (run_game) {
+      waitForInput(getUpdateDelayMs());
+      while (getAction(&action)) {
+        userInput(action, false);
+      }
     }
-    info = updateCurrentState();
-    run_game = showState(info);
   } while (run_game);
 }
 
-bool showState(GameInfo_t info) {
+// Sleeps until a key arrives or delay_ms pass, forever if delay_ms < 0
+void waitForInput(long delay_ms) {
+  struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+  int timeout = delay_ms > INT_MAX ? INT_MAX : (int)delay_ms;
+  poll(&input, 1, timeout);
+}
+
+Screen_t *getScreen() {
+  static Screen_t screen;
+  return &screen;
+}
+
+// Prints a cell only when it differs from what is shown
+void showCell(int line, int column, int *shown, int cell) {
+  Screen_t *screen = getScreen();
+  if (!screen->drawn || *shown != cell) {
+    *shown = cell;
+    mvprintw(line, column, "%s", cell ? "[]" : " .");
+  }
+}
+
+bool showState(const Frame_t *frame) {
+  PROFILE_START(show);
   bool run_game = true;
-  if (info.field == NULL || info.next == NULL) {
+  if (!frame->running) {
     run_game = false;
   } else {
     // int max_x, max_y;
@@ -37,7 +81,7 @@ bool showState(GameInfo_t info) {
     int left_line = 0;
     int right_line = 0;
     int left_side = 0;  // coordinate for field and help text
-    int right_side = 23;
+    int right_side = FIELD_COLS * 2 + 3;
 #ifdef DEBUG
     TetrisState_t *ptr_state = getState();
     TetrisInfo_t *ptr_info = getTetrisInfo();
@@ -52,43 +96,68 @@ bool showState(GameInfo_t info) {
              ptr_info->current.coordinate.x);
     int field_line = 0;
 #endif  // DEBUG
-    mvprintw(right_line++, right_side, "Score: %d          ", info.score);
-    mvprintw(right_line++, right_side, "High score: %d     ", info.high_score);
-    mvprintw(right_line++, right_side, "Level: %d          ", info.level);
-    mvprintw(right_line++, right_side, "Speed: %d          ", info.speed);
+    Screen_t *screen = getScreen();
+    if (!screen->drawn || screen->score != frame->score) {
+      mvprintw(right_line, right_side, "Score: %d          ", frame->score);
+    }
+    right_line++;
+    if (!screen->drawn || screen->high_score != frame->high_score) {
+      mvprintw(right_line, right_side, "High score: %d     ",
+               frame->high_score);
+    }
+    right_line++;
+    if (!screen->drawn || screen->level != frame->level) {
+      mvprintw(right_line, right_side, "Level: %d          ", frame->level);
+    }
+    right_line++;
+    if (!screen->drawn || screen->speed != frame->speed) {
+      mvprintw(right_line, right_side, "Speed: %d          ", frame->speed);
+    }
     right_line++;
-    mvprintw(right_line++, right_side, "Next:");
-    for (int i = 0; i < 4; i++, right_line++) {
-      for (int j = 0; j < 4; j++) {
-        mvprintw(right_line, right_side + j * 2, "%s",
-                 info.next[i][j] ? "[]" : " .");
+    screen->score = frame->score;
+    screen->high_score = frame->high_score;
+    screen->level = frame->level;
+    screen->speed = frame->speed;
+    right_line++;
+    if (!screen->drawn) {
+      mvprintw(right_line, right_side, "Next:");
+    }
+    right_line++;
+    for (int i = 0; i < NEXT_SIZE; i++, right_line++) {
+      for (int j = 0; j < NEXT_SIZE; j++) {
+        showCell(right_line, right_side + j * 2, &screen->next[i][j],
+                 (int)(frame->next[i] >> j & 1));
       }
     }
-    for (int i = 0; i < 20; i++, left_line++) {
+    for (int i = 0; i < FIELD_ROWS; i++, left_line++) {
 #ifdef DEBUG
       if (i == 0) {
-        for (int j = 0; j < 10; j++) {
+        for (int j = 0; j < FIELD_COLS; j++) {
           mvprintw(left_line, j * 2, "%2d", j);
         }
         left_line++;
       }
       mvprintw(left_line, 21, "%d", field_line++);
 #endif  // DEBUG
-      for (int j = 0; j < 10; j++) {
-        mvprintw(left_line, left_side + j * 2, "%s",
-                 info.field[i][j] ? "[]" : " .");
+      for (int j = 0; j < FIELD_COLS; j++) {
+        showCell(left_line, left_side + j * 2, &screen->field[i][j],
+                 (int)(frame->field[i] >> j & 1));
       }
     }
 #ifdef HELP
     left_line++;
-    mvprintw(left_line++, left_side, "%s", "'Enter' | start game");
-    mvprintw(left_line++, left_side, "%s", "  'f'   | pause / unpause");
-    mvprintw(left_line++, left_side, "%s", "  'q'   | exit");
-    mvprintw(left_line++, left_side, "%s", "'space' | action");
-    mvprintw(left_line++, left_side, "%s",
-             "'arrows'| move left, right, up, down");
+    if (!screen->drawn) {
+      mvprintw(left_line++, left_side, "%s", "'Enter' | start game");
+      mvprintw(left_line++, left_side, "%s", "  'f'   | pause / unpause");
+      mvprintw(left_line++, left_side, "%s", "  'q'   | exit");
+      mvprintw(left_line++, left_side, "%s", "'space' | action");
+      mvprintw(left_line++, left_side, "%s",
+               "'arrows'| move left, right, up, down");
+    }
 #endif  // #ifdef HELP
+    screen->drawn = true;
   }
+  PROFILE_STOP(show, kProfileShowState);
   return run_game;
 }
 
@@ -112,10 +181,12 @@ void debugWhichState(TetrisState_t *ptr_state, char *buffer) {
 #endif  // DEBUG
 
 // BrickGame function
+// Skips unknown keys, false once no keys are left
 bool getAction(UserAction_t *ptr_action) {
-  int signal = getch();
+  PROFILE_START(action);
+  int signal;
   bool is_key_pressed = false;
-  if (signal != ERR) {
+  while (!is_key_pressed && (signal = getch()) != ERR) {
     is_key_pressed = true;
     switch (signal) {
       case ENTER_KEY:
@@ -142,7 +213,14 @@ bool getAction(UserAction_t *ptr_action) {
       case KEY_Q_LOWER:
         *ptr_action = Terminate;
         break;
+      default:
+        is_key_pressed = false;
+        break;
     }
   }
+  if (is_key_pressed) {
+    PROFILE_INPUT();
+  }
+  PROFILE_STOP(action, kProfileGetAction);
   return is_key_pressed;
 }
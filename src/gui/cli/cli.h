@@ -18,9 +18,27 @@
 // for general case
 #include "../../brick_game/brick_game.h"
 
+#define FIELD_ROWS FRAME_ROWS
+#define FIELD_COLS FRAME_COLS
+#define NEXT_SIZE FRAME_NEXT
+
+/** What is on the screen now, showState() redraws only the differences */
+typedef struct {
+  bool drawn;
+  int field[FIELD_ROWS][FIELD_COLS];
+  int next[NEXT_SIZE][NEXT_SIZE];
+  int score;
+  int high_score;
+  int level;
+  int speed;
+} Screen_t;
+
 void initNcurses();
 void gameLoop();
-bool showState(GameInfo_t info);
+void waitForInput(long delay_ms);
+Screen_t *getScreen();
+bool showState(const Frame_t *frame);
+void showCell(int line, int column, int *shown, int cell);
 bool getAction();
 
 #ifdef DEBUG
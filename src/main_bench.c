@@ -0,0 +1,81 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <unistd.h>
+
+#include "bench/bench.h"
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-w warmup] [-r samples] [-g games] [-s seed]\n"
+          "          [-f filter] [-o file.json]\n"
+          "  -r  samples of %d operations per case, percentiles are over them\n"
+          "  -f  only the cases whose name contains filter\n"
+          "  -o  also write the results as JSON\n",
+          name, kBenchBatch);
+}
+
+int main(int argc, char **argv) {
+  BenchConfig_t config = {
+      .warmup = 20, .samples = 200, .games = 50, .seed = 1, .filter = NULL};
+  const char *json_path = NULL;
+  bool ok = true;
+  int opt;
+  while (ok && (opt = getopt(argc, argv, "w:r:g:s:f:o:")) != -1) {
+    switch (opt) {
+      case 'w':
+        config.warmup = atoi(optarg);
+        break;
+      case 'r':
+        config.samples = atoi(optarg);
+        break;
+      case 'g':
+        config.games = atoi(optarg);
+        break;
+      case 's':
+        config.seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'f':
+        config.filter = optarg;
+        break;
+      case 'o':
+        json_path = optarg;
+        break;
+      default:
+        ok = false;
+        break;
+    }
+  }
+  ok = ok && config.warmup >= 0 && config.samples > 0 &&
+       config.samples <= kBenchMaxSamples && config.games >= 0;
+  BenchResult_t results[kBenchMaxCases] = {{0}};
+  BenchGames_t games = {0};
+  int count = 0;
+  bool valid = ok;
+  if (!valid) {
+    printUsage(argv[0]);
+  }
+  for (int i = 0; ok && i < kBenchCaseCount && count < kBenchMaxCases; i++) {
+    const BenchCase_t *bench = &kBenchCases[i];
+    if (config.filter == NULL || strstr(bench->name, config.filter)) {
+      ok = runBenchCase(bench, &config, &results[count++]);
+    }
+  }
+  ok = ok && runBenchGames(&config, &games);
+  if (ok) {
+    printBenchTable(results, count, &games, stdout);
+  } else if (valid) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+  }
+  if (ok && json_path) {
+    FILE *json = fopen(json_path, "w");
+    ok = json != NULL;
+    if (ok) {
+      printBenchJson(results, count, &games, json);
+      ok = fclose(json) == 0;
+    }
+    if (!ok) {
+      fprintf(stderr, "%s: could not write %s\n", argv[0], json_path);
+    }
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
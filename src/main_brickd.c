@@ -0,0 +1,55 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <unistd.h>
+
+#include "server/server.h"
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-s socket] [-t workers] [-m sessions_per_worker]\n"
+          "  -s  defaults to $XDG_RUNTIME_DIR/brickd.sock or /tmp\n",
+          name);
+}
+
+int main(int argc, char **argv) {
+  char path[256];
+  const char *runtime = getenv("XDG_RUNTIME_DIR");
+  snprintf(path, sizeof(path), "%s/brickd.sock",
+           runtime && runtime[0] ? runtime : "/tmp");
+  // One worker per core by default, only an explicit -t past the cap fails
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  ServerConfig_t config = {.path = path,
+                           .workers = cores < kServerMaxWorkers
+                                          ? (int)cores
+                                          : kServerMaxWorkers,
+                           .max_sessions = 1024};
+  bool ok = true;
+  int opt;
+  while (ok && (opt = getopt(argc, argv, "s:t:m:")) != -1) {
+    switch (opt) {
+      case 's':
+        config.path = optarg;
+        break;
+      case 't':
+        config.workers = atoi(optarg);
+        break;
+      case 'm':
+        config.max_sessions = atoi(optarg);
+        break;
+      default:
+        ok = false;
+        break;
+    }
+  }
+  if (config.workers < 1) {
+    config.workers = 1;
+  }
+  ok = ok && config.workers <= kServerMaxWorkers && config.max_sessions > 0;
+  if (!ok) {
+    printUsage(argv[0]);
+  } else if (!runServer(&config)) {
+    fprintf(stderr, "%s: could not serve on %s\n", argv[0], config.path);
+    ok = false;
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
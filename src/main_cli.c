@@ -1,8 +1,36 @@
+#include "brick_game/profile/profile.h"
+#include "brick_game/tetris/highscore.h"
+#include "brick_game/tetris/replay.h"
+#include "brick_game/tetris/spectate.h"
 #include "gui/cli/cli.h"
 
-int main() {
+// ./game --record FILE writes every input of the session to FILE
+// ./game --broadcast NAME lets ./brick_watch NAME follow the game
+int main(int argc, char **argv) {
+  Recorder_t recorder;
+  Broadcaster_t broadcaster;
+  FILE *log = NULL;
+  bool broadcasting = false;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--record") == 0 && log == NULL) {
+      log = fopen(argv[i + 1], "wb");
+      startRecording(&recorder, getTetrisInfo(), log, (uint64_t)time(NULL));
+    } else if (strcmp(argv[i], "--broadcast") == 0 && !broadcasting) {
+      broadcasting =
+          startBroadcast(&broadcaster, getTetrisInfo(), argv[i + 1]);
+    }
+  }
   initNcurses();
   gameLoop();
   endwin();
+  flushScores();
+  PROFILE_DUMP(stderr);
+  if (broadcasting) {
+    stopBroadcast(&broadcaster, getTetrisInfo());
+  }
+  if (log) {
+    stopRecording(&recorder, getTetrisInfo());
+    fclose(log);
+  }
   return 0;
 }
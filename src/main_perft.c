@@ -0,0 +1,84 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <unistd.h>
+
+#include "perft/perft.h"
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-d depth] [-t threads] [-s seed] [-b] [-q figures]\n"
+          "          [-H table_mb] [-e expected_nodes]\n"
+          "  -q  figure letters of IJLOSTZ instead of the seeded game\n"
+          "  -b  7-bag randomizer instead of uniform figures\n"
+          "  -H  cache subtree counts by board hash in a table of that size\n"
+          "  -e  fail unless the count of the last ply is this\n",
+          name);
+}
+
+int main(int argc, char **argv) {
+  // One thread per core by default, only an explicit -t past the cap fails
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  PerftConfig_t config = {.depth = 3,
+                          .threads = cores < kPerftMaxThreads
+                                         ? (int)cores
+                                         : kPerftMaxThreads,
+                          .seed = 1,
+                          .randomizer = kRandomizerUniform};
+  unsigned long long expected = 0;
+  bool check = false;
+  bool ok = true;
+  int opt;
+  while (ok && (opt = getopt(argc, argv, "d:t:s:bq:H:e:")) != -1) {
+    switch (opt) {
+      case 'd':
+        config.depth = atoi(optarg);
+        break;
+      case 't':
+        config.threads = atoi(optarg);
+        break;
+      case 's':
+        config.seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'b':
+        config.randomizer = kRandomizerBag;
+        break;
+      case 'q':
+        config.sequence = optarg;
+        break;
+      case 'H':
+        config.table_bytes = strtoull(optarg, NULL, 10) << 20;
+        break;
+      case 'e':
+        expected = strtoull(optarg, NULL, 10);
+        check = true;
+        break;
+      default:
+        ok = false;
+        break;
+    }
+  }
+  if (config.threads < 1) {
+    config.threads = 1;
+  }
+  ok = ok && config.threads <= kPerftMaxThreads;
+  PerftReport_t *report = ok ? calloc(1, sizeof(PerftReport_t)) : NULL;
+  if (!ok) {
+    printUsage(argv[0]);
+  } else if (report && runPerft(&config, report)) {
+    printPerftReport(report, stdout);
+    if (check && report->nodes != expected) {
+      fprintf(stderr, "%s: expected %llu nodes, counted %llu\n", argv[0],
+              expected, report->nodes);
+      ok = false;
+    }
+  } else {
+    fprintf(stderr, "%s: bad figure sequence or depth\n", argv[0]);
+    printUsage(argv[0]);
+    ok = false;
+  }
+  if (report) {
+    freePerftReport(report);
+    free(report);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,19 @@
+#include "brick_game/tetris/replay.h"
+
+// Replays every log given on the command line and checks its final state
+int main(int argc, char **argv) {
+  int failed = 0;
+  for (int i = 1; i < argc; i++) {
+    ReplayResult_t result = {0};
+    FILE *file = fopen(argv[i], "rb");
+    bool ok = file != NULL && replayLog(file, &result);
+    if (file) {
+      fclose(file);
+    }
+    printf("%s: %s, %lu events, %lu ticks, score %d (expected %d)\n", argv[i],
+           ok ? "ok" : "MISMATCH", result.events, result.ticks, result.score,
+           result.expected_score);
+    failed += !ok;
+  }
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,96 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <unistd.h>
+
+#include "sim/sim.h"
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-g games] [-t threads] [-s first_seed] [-m max_pieces]\n"
+          "          [-p random|scripted|bot|beam] [-S script] [-b]\n"
+          "          [-w beam_width] [-d beam_depth]\n"
+          "  -S  keys for -p scripted: l r a d, '.' waits one step\n"
+          "  -b  7-bag randomizer instead of uniform figures\n"
+          "  -w, -d  boards per ply and plies of -p beam, it runs without a\n"
+          "          time budget on the game's thread so runs repeat\n",
+          name);
+}
+
+int main(int argc, char **argv) {
+  // One thread per core by default, only an explicit -t past the cap fails
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  SimConfig_t config = {.games = 1000,
+                        .threads = cores < kSimMaxThreads ? (int)cores
+                                                          : kSimMaxThreads,
+                        .first_seed = 1,
+                        .policy = kPolicyRandom,
+                        .script = "lla.rrd",
+                        .max_pieces = 10000,
+                        .randomizer = kRandomizerUniform,
+                        .beam = kBeamDefaults};
+  config.beam.threads = 1;
+  config.beam.budget_ms = 0;
+  bool ok = true;
+  int opt;
+  while (ok && (opt = getopt(argc, argv, "g:t:s:m:p:S:bw:d:")) != -1) {
+    switch (opt) {
+      case 'g':
+        config.games = atoi(optarg);
+        break;
+      case 't':
+        config.threads = atoi(optarg);
+        break;
+      case 's':
+        config.first_seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'm':
+        config.max_pieces = strtoul(optarg, NULL, 10);
+        break;
+      case 'p':
+        if (strcmp(optarg, "random") == 0) {
+          config.policy = kPolicyRandom;
+        } else if (strcmp(optarg, "scripted") == 0) {
+          config.policy = kPolicyScripted;
+        } else if (strcmp(optarg, "bot") == 0) {
+          config.policy = kPolicyBot;
+        } else if (strcmp(optarg, "beam") == 0) {
+          config.policy = kPolicyBeam;
+        } else {
+          ok = false;
+        }
+        break;
+      case 'S':
+        config.script = optarg;
+        break;
+      case 'b':
+        config.randomizer = kRandomizerBag;
+        break;
+      case 'w':
+        config.beam.width = atoi(optarg);
+        break;
+      case 'd':
+        config.beam.depth = atoi(optarg);
+        break;
+      default:
+        ok = false;
+        break;
+    }
+  }
+  if (config.threads < 1) {
+    config.threads = 1;
+  }
+  ok = ok && config.games >= 0 && config.threads <= kSimMaxThreads &&
+       config.beam.width >= 1 && config.beam.width <= kBeamMaxWidth &&
+       config.beam.depth >= 1;
+  SimReport_t report = {0};
+  if (!ok) {
+    printUsage(argv[0]);
+  } else if (runSimulation(&config, &report)) {
+    printSimReport(&report, stdout);
+  } else {
+    fprintf(stderr, "%s: could not start the simulation\n", argv[0]);
+    ok = false;
+  }
+  freeSimReport(&report);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
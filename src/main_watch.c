@@ -0,0 +1,29 @@
+#include "brick_game/tetris/spectate.h"
+#include "gui/cli/cli.h"
+
+// ./brick_watch NAME shows the game started with ./game --broadcast NAME
+int main(int argc, char **argv) {
+  Spectator_t spectator;
+  bool ok = argc == 2 && attachSpectator(&spectator, argv[1]);
+  if (!ok) {
+    fprintf(stderr, "usage: %s NAME, for a game run with --broadcast NAME\n",
+            argv[0]);
+  } else {
+    initNcurses();
+    bool watching = true;
+    while (watching) {
+      if (pollSpectator(&spectator) == kSpectateFrame) {
+        watching = showState(&spectator.frame);
+        refresh();
+      }
+      waitForInput(kSpectatePollMs);
+      UserAction_t action;
+      while (getAction(&action)) {
+        watching = watching && action != Terminate;
+      }
+    }
+    endwin();
+    detachSpectator(&spectator);
+  }
+  return ok ? 0 : 1;
+}
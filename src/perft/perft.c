@@ -0,0 +1,200 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "perft.h"
+
+// Letters of Tetromino_t in enum order
+static const char kFigureLetters[] = "ILOTSZJ";
+
+static double clockSec(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// The figures in the order a game deals them, false on a bad sequence
+bool perftFigures(const PerftConfig_t *config, Tetromino_t *figures) {
+  bool ok = config->depth >= 1 && config->depth <= kPerftMaxDepth;
+  if (ok && config->sequence) {
+    ok = (int)strlen(config->sequence) >= config->depth;
+    for (int i = 0; ok && i < config->depth; i++) {
+      const char *letter = strchr(kFigureLetters, config->sequence[i]);
+      ok = letter != NULL && *letter != '\0';
+      figures[i] = ok ? (Tetromino_t)(letter - kFigureLetters) : kFigureI;
+    }
+  } else if (ok) {
+    TetrisInfo_t *game = createTetrisGame();
+    ok = game != NULL;
+    if (ok) {
+      seedTetrisGame(game, config->seed);
+      setRandomizer(game, config->randomizer);
+      for (int i = 0; i < config->depth; i++) {
+        figures[i] = drawFigure(game);
+      }
+      destroyTetrisGame(game);
+    }
+  }
+  return ok;
+}
+
+// Key of a subtree: cells below the field stand for the ply
+static uint64_t subtreeKey(uint64_t hash, int ply) {
+  return hash ^ cellKey(kRows + ply, 0);
+}
+
+// Nodes under a placement of the ply's figure, the ply of the move included
+static unsigned long long perftChild(PerftSearch_t *search, const Row_t *field,
+                                     uint64_t hash, int ply,
+                                     const Move_t *move) {
+  const Orientation_t *shape =
+      &kOrientations[search->figures[ply]][move->rotation];
+  unsigned long long nodes = 1;
+  if (ply + 1 < search->depth) {
+    nodes = 0;
+    // Same loss rule as evaluatePlacement(), a lost game has no next ply
+    if (move->y + shape->box.bottom > 0) {
+      Row_t rows[kRows];
+      memcpy(rows, field, sizeof(rows));
+      int lines = placeOnRows(rows, shape, move->x, move->y);
+      hash = lines > 0 ? rowsKey(rows)
+                       : hash ^ figureKey(shape, move->x, move->y);
+      nodes = perftCount(search, rows, hash, ply + 1);
+    }
+  }
+  return nodes;
+}
+
+// Placement sequences of the figures from ply on, hash is rowsKey(field)
+unsigned long long perftCount(PerftSearch_t *search, const Row_t *field,
+                              uint64_t hash, int ply) {
+  unsigned long long nodes = 1;
+  // The last ply is counted without placing its figures, not worth a probe
+  bool cached = search->table && ply + 1 < search->depth;
+  uint64_t key = subtreeKey(hash, ply);
+  uint64_t stored = 0;
+  if (cached && probeTTable(search->table, key, &stored)) {
+    nodes = stored;
+    search->hits++;
+  } else if (ply < search->depth) {
+    Tetromino_t type = search->figures[ply];
+    MoveList_t *moves = &search->lists[ply];
+    int count = generateMoves(search->gen, field, type, 0,
+                              spawnCoordinate(type), moves);
+    nodes = (unsigned long long)count;
+    if (ply + 1 < search->depth) {
+      nodes = 0;
+      for (int i = 0; i < count; i++) {
+        nodes += perftChild(search, field, hash, ply, &moves->move[i]);
+      }
+    }
+    if (cached) {
+      storeTTable(search->table, key, nodes);
+    }
+  }
+  return nodes;
+}
+
+// Takes the next unclaimed root until none is left
+static void *perftWorker(void *arg) {
+  PerftWorker_t *worker = arg;
+  PerftReport_t *report = worker->report;
+  double cpu_start = clockSec(CLOCK_THREAD_CPUTIME_ID);
+  PerftSearch_t search = {
+      .gen = malloc(sizeof(MoveGen_t)),
+      .lists = malloc(sizeof(MoveList_t) * report->depth),
+      .table = report->use_table ? &report->table : NULL,
+      .figures = report->figures,
+      .depth = report->depth};
+  if (search.gen && search.lists) {
+    uint64_t hash = rowsKey(report->field);
+    int root;
+    while ((root = atomic_fetch_add_explicit(&report->next_root, 1,
+                                             memory_order_relaxed)) <
+           report->root_count) {
+      PerftRoot_t *entry = &report->roots[root];
+      entry->nodes =
+          perftChild(&search, report->field, hash, 0, &entry->move);
+      worker->nodes += entry->nodes;
+    }
+  }
+  worker->hits = search.hits;
+  free(search.lists);
+  free(search.gen);
+  worker->busy_sec = clockSec(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+  return NULL;
+}
+
+// Splits the work at the placements of the first figure
+bool runPerft(const PerftConfig_t *config, PerftReport_t *report) {
+  memset(report, 0, sizeof(*report));
+  report->depth = config->depth;
+  report->threads = config->threads;
+  bool ok = config->threads > 0 && config->threads <= kPerftMaxThreads &&
+            perftFigures(config, report->figures);
+  double wall_start = clockSec(CLOCK_MONOTONIC);
+  MoveGen_t *gen = ok ? malloc(sizeof(MoveGen_t)) : NULL;
+  MoveList_t *moves = ok ? malloc(sizeof(MoveList_t)) : NULL;
+  ok = gen != NULL && moves != NULL;
+  if (ok) {
+    Tetromino_t first = report->figures[0];
+    report->root_count = generateMoves(gen, report->field, first, 0,
+                                       spawnCoordinate(first), moves);
+    report->roots = calloc(report->root_count > 0 ? report->root_count : 1,
+                           sizeof(PerftRoot_t));
+    ok = report->roots != NULL;
+  }
+  for (int i = 0; ok && i < report->root_count; i++) {
+    report->roots[i].move = moves->move[i];
+  }
+  free(moves);
+  free(gen);
+  if (ok && config->table_bytes > 0) {
+    ok = createTTable(&report->table, config->table_bytes);
+    report->use_table = ok;
+  }
+  atomic_init(&report->next_root, 0);
+  int started = 0;
+  for (int i = 0; ok && i < config->threads; i++) {
+    PerftWorker_t *worker = &report->worker[i];
+    worker->report = report;
+    ok = pthread_create(&worker->thread, NULL, perftWorker, worker) == 0;
+    started += ok;
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(report->worker[i].thread, NULL);
+    report->nodes += report->worker[i].nodes;
+  }
+  report->wall_sec = clockSec(CLOCK_MONOTONIC) - wall_start;
+  return ok;
+}
+
+void freePerftReport(PerftReport_t *report) {
+  free(report->roots);
+  report->roots = NULL;
+  if (report->use_table) {
+    destroyTTable(&report->table);
+    report->use_table = false;
+  }
+}
+
+// One line per root placement, then the total and the throughput
+void printPerftReport(const PerftReport_t *report, FILE *out) {
+  double wall = report->wall_sec > 0 ? report->wall_sec : 1e-9;
+  fprintf(out, "figures    ");
+  for (int i = 0; i < report->depth; i++) {
+    fputc(kFigureLetters[report->figures[i]], out);
+  }
+  fprintf(out, "\n");
+  for (int i = 0; i < report->root_count; i++) {
+    const PerftRoot_t *root = &report->roots[i];
+    fprintf(out, "r%d x%-3d y%-3d %llu\n", root->move.rotation, root->move.x,
+            root->move.y, root->nodes);
+  }
+  fprintf(out, "depth %-4d %llu nodes in %.3f s, %.0f nodes/s\n",
+          report->depth, report->nodes, report->wall_sec,
+          report->nodes / wall);
+  for (int i = 0; i < report->threads; i++) {
+    const PerftWorker_t *worker = &report->worker[i];
+    fprintf(out, "thread %-3d %llu nodes, %llu table hits, %.1f%% busy\n", i,
+            worker->nodes, worker->hits, 100.0 * worker->busy_sec / wall);
+  }
+}
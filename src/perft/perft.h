@@ -0,0 +1,77 @@
+#ifndef BRICK_GAME_PERFT_PERFT_H_
+#define BRICK_GAME_PERFT_PERFT_H_
+
+#include <pthread.h>
+
+#include "../brick_game/bot/bot.h"
+#include "../brick_game/tetris/tetris.h"
+
+/**
+ * Counts every sequence of placements the move generator allows for a fixed
+ * figure sequence, like perft of chess engines. A placement that ends the
+ * game is counted at the last ply only, the game has no move after it.
+ */
+typedef enum {
+  kPerftMaxDepth = 16,
+  kPerftMaxThreads = 256,
+  kPerftMaxRoots = kMaxMoves
+} PerftLimits_t;
+
+typedef struct {
+  int depth;
+  int threads;
+  uint64_t seed;  // figures of a game seeded with it, unless sequence is set
+  Randomizer_t randomizer;
+  const char *sequence;  // letters of IJLOSTZ, one per ply, NULL draws
+  size_t table_bytes;    // transposition table of subtree counts, 0 is none
+} PerftConfig_t;
+
+/** Scratch memory of one counting thread */
+typedef struct {
+  MoveGen_t *gen;
+  MoveList_t *lists;  // one per ply
+  TTable_t *table;    // NULL counts every subtree
+  const Tetromino_t *figures;
+  int depth;
+  unsigned long long hits;
+} PerftSearch_t;
+
+typedef struct PerftReport PerftReport_t;
+
+/** Nodes under one placement of the first figure */
+typedef struct {
+  Move_t move;
+  unsigned long long nodes;
+} PerftRoot_t;
+
+typedef struct {
+  pthread_t thread;
+  PerftReport_t *report;
+  unsigned long long nodes;
+  unsigned long long hits;  // subtrees found in the table
+  double busy_sec;          // thread CPU time
+} PerftWorker_t;
+
+struct PerftReport {
+  Tetromino_t figures[kPerftMaxDepth];
+  int depth;
+  int threads;
+  Row_t field[kRows];
+  PerftRoot_t *roots;
+  int root_count;
+  atomic_int next_root;  // roots are handed out one at a time
+  TTable_t table;
+  bool use_table;
+  unsigned long long nodes;
+  double wall_sec;
+  PerftWorker_t worker[kPerftMaxThreads];
+};
+
+bool perftFigures(const PerftConfig_t *config, Tetromino_t *figures);
+unsigned long long perftCount(PerftSearch_t *search, const Row_t *field,
+                              uint64_t hash, int ply);
+bool runPerft(const PerftConfig_t *config, PerftReport_t *report);
+void freePerftReport(PerftReport_t *report);
+void printPerftReport(const PerftReport_t *report, FILE *out);
+
+#endif  // BRICK_GAME_PERFT_PERFT_H_
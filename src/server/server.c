@@ -0,0 +1,404 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+// What an epoll event is about, kept in the low bits of its data. The slot
+// comes above it and the generation of the slot's session in the high half
+typedef enum {
+  kSourceClient,
+  kSourceTimer,
+  kSourceInbox,
+  kSourceBits = 2
+} EventSource_t;
+
+static uint64_t eventTag(int slot, uint32_t generation, EventSource_t source) {
+  return (uint64_t)generation << 32 | (uint64_t)slot << kSourceBits | source;
+}
+
+static void putLittleEndian(uint8_t *bytes, uint64_t value, int size) {
+  for (int i = 0; i < size; i++) {
+    bytes[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint64_t getLittleEndian(const uint8_t *bytes, int size) {
+  uint64_t value = 0;
+  for (int i = 0; i < size; i++) {
+    value |= (uint64_t)bytes[i] << (8 * i);
+  }
+  return value;
+}
+
+void encodeFrame(const Frame_t *frame, uint8_t *message) {
+  putLittleEndian(message, frame->version, 8);
+  putLittleEndian(message + 8, (uint32_t)frame->score, 4);
+  putLittleEndian(message + 12, (uint32_t)frame->high_score, 4);
+  message[16] = (uint8_t)frame->level;
+  message[17] = (uint8_t)frame->speed;
+  message[18] = (uint8_t)((frame->pause != 0) | frame->running << 1);
+  uint16_t next = 0;
+  for (int i = 0; i < FRAME_NEXT; i++) {
+    next |= (uint16_t)((frame->next[i] & 0xF) << (4 * i));
+  }
+  putLittleEndian(message + 19, next, 2);
+  for (int i = 0; i < FRAME_ROWS; i++) {
+    putLittleEndian(message + kFrameHeaderBytes + i * kRowBytes,
+                    frame->field[i], kRowBytes);
+  }
+}
+
+void decodeFrame(const uint8_t *message, Frame_t *frame) {
+  frame->version = (unsigned long)getLittleEndian(message, 8);
+  frame->score = (int)getLittleEndian(message + 8, 4);
+  frame->high_score = (int)getLittleEndian(message + 12, 4);
+  frame->level = message[16];
+  frame->speed = message[17];
+  frame->pause = message[18] & 1;
+  frame->running = (message[18] >> 1) & 1;
+  uint16_t next = (uint16_t)getLittleEndian(message + 19, 2);
+  for (int i = 0; i < FRAME_NEXT; i++) {
+    frame->next[i] = (next >> (4 * i)) & 0xF;
+  }
+  for (int i = 0; i < FRAME_ROWS; i++) {
+    frame->field[i] = (BoardRow_t)getLittleEndian(
+        message + kFrameHeaderBytes + i * kRowBytes, kRowBytes);
+  }
+}
+
+static bool setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void watchClient(ServerWorker_t *worker, int slot, bool want_write) {
+  Session_t *session = &worker->session[slot];
+  struct epoll_event event = {
+      .events = EPOLLIN | (want_write ? EPOLLOUT : 0),
+      .data.u64 = eventTag(slot, session->generation, kSourceClient)};
+  epoll_ctl(worker->epoll, EPOLL_CTL_MOD, session->fd, &event);
+  session->want_write = want_write;
+}
+
+static void closeSession(ServerWorker_t *worker, int slot) {
+  Session_t *session = &worker->session[slot];
+  epoll_ctl(worker->epoll, EPOLL_CTL_DEL, session->fd, NULL);
+  epoll_ctl(worker->epoll, EPOLL_CTL_DEL, session->timer, NULL);
+  close(session->fd);
+  close(session->timer);
+  destroyTetrisGame(session->game);
+  session->game = NULL;
+  worker->free_slot[worker->free_count++] = slot;
+  atomic_fetch_sub(&worker->sessions, 1);
+}
+
+// Arms the one-shot timer for the next gravity step, disarms it in pauses
+static void scheduleGravity(Session_t *session) {
+  long delay = nextShiftDelayMs(session->game);
+  struct itimerspec spec = {{0, 0}, {0, 0}};
+  if (delay > 0) {
+    spec.it_value.tv_sec = delay / 1000;
+    spec.it_value.tv_nsec = delay % 1000 * 1000000;
+  } else if (delay == 0) {
+    spec.it_value.tv_nsec = 1;  // zero would disarm it
+  }
+  timerfd_settime(session->timer, 0, &spec, NULL);
+}
+
+// Sends the latest frame as far as the socket takes it, false on errors
+static bool flushSession(ServerWorker_t *worker, int slot) {
+  Session_t *session = &worker->session[slot];
+  bool ok = true;
+  bool blocked = false;
+  while (ok && !blocked &&
+         (session->out_sent < session->out_length || session->frame_due)) {
+    if (session->out_sent == session->out_length) {
+      encodeFrame(getTetrisFrame(session->game), session->out);
+      session->out_length = kFrameMessageBytes;
+      session->out_sent = 0;
+      session->frame_due = false;
+      worker->frames++;
+    }
+    ssize_t sent = send(session->fd, session->out + session->out_sent,
+                        session->out_length - session->out_sent, MSG_NOSIGNAL);
+    if (sent > 0) {
+      session->out_sent += (int)sent;
+    } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      blocked = true;
+    } else if (sent < 0 && errno != EINTR) {
+      ok = false;
+    }
+  }
+  if (ok && blocked != session->want_write) {
+    watchClient(worker, slot, blocked);
+  }
+  return ok;
+}
+
+// Common tail of inputs and gravity steps
+static void afterChange(ServerWorker_t *worker, int slot,
+                        unsigned long version) {
+  Session_t *session = &worker->session[slot];
+  scheduleGravity(session);
+  session->frame_due = session->frame_due || session->game->version != version;
+  bool ok = flushSession(worker, slot);
+  bool done = !session->game->run_game &&
+              session->out_sent == session->out_length && !session->frame_due;
+  if (!ok || done) {
+    closeSession(worker, slot);
+  }
+}
+
+static void openSession(ServerWorker_t *worker, int fd) {
+  int slot = worker->free_count > 0 ? worker->free_slot[--worker->free_count]
+                                    : -1;
+  Session_t *session = slot >= 0 ? &worker->session[slot] : NULL;
+  bool ok = session != NULL;
+  if (ok) {
+    uint32_t generation = session->generation + 1;
+    memset(session, 0, sizeof(*session));
+    session->generation = generation;
+    session->fd = fd;
+    session->game = createTetrisGame();
+    session->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    struct epoll_event client = {
+        .events = EPOLLIN,
+        .data.u64 = eventTag(slot, generation, kSourceClient)};
+    struct epoll_event timer = {
+        .events = EPOLLIN,
+        .data.u64 = eventTag(slot, generation, kSourceTimer)};
+    ok = session->game != NULL && session->timer >= 0 &&
+         epoll_ctl(worker->epoll, EPOLL_CTL_ADD, fd, &client) == 0 &&
+         epoll_ctl(worker->epoll, EPOLL_CTL_ADD, session->timer, &timer) == 0;
+    worker->served++;
+    if (ok) {
+      session->frame_due = true;
+      afterChange(worker, slot, session->game->version);
+    } else {
+      closeSession(worker, slot);
+    }
+  } else {
+    close(fd);
+    atomic_fetch_sub(&worker->sessions, 1);
+  }
+}
+
+static void readInputs(ServerWorker_t *worker, int slot) {
+  Session_t *session = &worker->session[slot];
+  uint8_t input[kServerReadBytes];
+  ssize_t count = read(session->fd, input, sizeof(input));
+  if (count > 0) {
+    unsigned long version = session->game->version;
+    for (ssize_t i = 0; i < count && session->game->run_game; i++) {
+      tetrisUserInput(session->game, (UserAction_t)(input[i] & 7),
+                      (input[i] >> 3) & 1);
+    }
+    worker->inputs += (unsigned long)count;
+    afterChange(worker, slot, version);
+  } else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+    closeSession(worker, slot);
+  }
+}
+
+static void stepGravity(ServerWorker_t *worker, int slot) {
+  Session_t *session = &worker->session[slot];
+  uint64_t expirations;
+  if (read(session->timer, &expirations, sizeof(expirations)) > 0) {
+    unsigned long version = session->game->version;
+    applyGravity(session->game);
+    afterChange(worker, slot, version);
+  }
+}
+
+// New connections arrive as fds on the inbox pipe, -1 asks to stop
+static bool readInbox(ServerWorker_t *worker) {
+  bool running = true;
+  int fd;
+  while (read(worker->inbox[0], &fd, sizeof(fd)) == sizeof(fd)) {
+    if (fd < 0) {
+      running = false;
+    } else {
+      openSession(worker, fd);
+    }
+  }
+  return running;
+}
+
+static void *workerMain(void *arg) {
+  ServerWorker_t *worker = arg;
+  struct epoll_event events[64];
+  bool running = true;
+  while (running) {
+    int count = epoll_wait(worker->epoll, events, 64, -1);
+    for (int i = 0; i < count; i++) {
+      uint64_t tag = events[i].data.u64;
+      int slot = (int)((uint32_t)tag >> kSourceBits);
+      uint32_t generation = (uint32_t)(tag >> 32);
+      EventSource_t source = tag & ((1u << kSourceBits) - 1);
+      if (source == kSourceInbox) {
+        running = readInbox(worker) && running;
+      } else if (worker->session[slot].game == NULL ||
+                 worker->session[slot].generation != generation) {
+        // Closed by an earlier event of this batch, maybe reopened for a
+        // new client by the inbox since
+      } else if (source == kSourceTimer) {
+        stepGravity(worker, slot);
+      } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        readInputs(worker, slot);
+      } else if (!flushSession(worker, slot)) {
+        closeSession(worker, slot);
+      }
+    }
+  }
+  for (int slot = 0; slot < worker->max_sessions; slot++) {
+    if (worker->session[slot].game) {
+      closeSession(worker, slot);
+    }
+  }
+  return NULL;
+}
+
+static bool startWorker(ServerWorker_t *worker, int index, int max_sessions) {
+  memset(worker, 0, sizeof(*worker));
+  worker->inbox[0] = worker->inbox[1] = -1;
+  worker->index = index;
+  worker->max_sessions = max_sessions;
+  worker->session = calloc(max_sessions, sizeof(Session_t));
+  worker->free_slot = calloc(max_sessions, sizeof(int));
+  worker->epoll = epoll_create1(0);
+  bool ok = worker->session && worker->free_slot && worker->epoll >= 0 &&
+            pipe(worker->inbox) == 0 && setNonBlocking(worker->inbox[0]);
+  for (int i = 0; ok && i < max_sessions; i++) {
+    worker->free_slot[worker->free_count++] = max_sessions - 1 - i;
+  }
+  struct epoll_event inbox = {.events = EPOLLIN,
+                              .data.u64 = eventTag(0, 0, kSourceInbox)};
+  ok = ok &&
+       epoll_ctl(worker->epoll, EPOLL_CTL_ADD, worker->inbox[0], &inbox) == 0;
+  ok = ok && pthread_create(&worker->thread, NULL, workerMain, worker) == 0;
+  return ok;
+}
+
+static void freeWorker(ServerWorker_t *worker) {
+  for (int i = 0; i < 2; i++) {
+    if (worker->inbox[i] >= 0) {
+      close(worker->inbox[i]);
+    }
+  }
+  if (worker->epoll >= 0) {
+    close(worker->epoll);
+  }
+  free(worker->session);
+  free(worker->free_slot);
+}
+
+static int listenOn(const char *path) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  int fd = strlen(path) < sizeof(address.sun_path)
+               ? socket(AF_UNIX, SOCK_STREAM, 0)
+               : -1;
+  if (fd >= 0) {
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0 || !setNonBlocking(fd)) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  return fd;
+}
+
+// Least loaded worker, the sessions stay with it until they end
+static ServerWorker_t *pickWorker(ServerWorker_t *workers, int count) {
+  ServerWorker_t *best = &workers[0];
+  for (int i = 1; i < count; i++) {
+    if (atomic_load(&workers[i].sessions) < atomic_load(&best->sessions)) {
+      best = &workers[i];
+    }
+  }
+  return best;
+}
+
+static void acceptClients(int listener, ServerWorker_t *workers, int count) {
+  int fd;
+  while ((fd = accept(listener, NULL, NULL)) >= 0) {
+    if (setNonBlocking(fd)) {
+      // Counted here already, so a burst of clients spreads out too
+      ServerWorker_t *worker = pickWorker(workers, count);
+      atomic_fetch_add(&worker->sessions, 1);
+      if (write(worker->inbox[1], &fd, sizeof(fd)) != sizeof(fd)) {
+        atomic_fetch_sub(&worker->sessions, 1);
+        close(fd);
+      }
+    } else {
+      close(fd);
+    }
+  }
+}
+
+// Accepts on the calling thread until SIGINT or SIGTERM
+bool runServer(const ServerConfig_t *config) {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  // Blocked before the workers start, so only the signalfd sees them
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+  int stop = signalfd(-1, &signals, 0);
+  int listener = listenOn(config->path);
+  int epoll = epoll_create1(0);
+  ServerWorker_t *workers = calloc(config->workers, sizeof(ServerWorker_t));
+  bool ok = stop >= 0 && listener >= 0 && epoll >= 0 && workers != NULL;
+  int tried = 0;
+  int started = 0;
+  for (; ok && tried < config->workers; tried++) {
+    ok = startWorker(&workers[tried], tried, config->max_sessions);
+    started += ok;
+  }
+  struct epoll_event accept_event = {.events = EPOLLIN, .data.fd = listener};
+  struct epoll_event stop_event = {.events = EPOLLIN, .data.fd = stop};
+  ok = ok && epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &accept_event) == 0 &&
+       epoll_ctl(epoll, EPOLL_CTL_ADD, stop, &stop_event) == 0;
+  if (ok) {
+    fprintf(stderr, "brickd: %d workers on %s\n", started, config->path);
+  }
+  bool running = ok;
+  while (running) {
+    struct epoll_event event;
+    if (epoll_wait(epoll, &event, 1, -1) == 1) {
+      if (event.data.fd == listener) {
+        acceptClients(listener, workers, started);
+      } else {
+        running = false;
+      }
+    }
+  }
+  for (int i = 0; i < started; i++) {
+    int quit = -1;
+    if (write(workers[i].inbox[1], &quit, sizeof(quit)) == sizeof(quit)) {
+      pthread_join(workers[i].thread, NULL);
+    }
+    fprintf(stderr, "worker %-3d %lu sessions, %lu inputs, %lu frames\n", i,
+            workers[i].served, workers[i].inputs, workers[i].frames);
+  }
+  for (int i = 0; i < tried; i++) {
+    freeWorker(&workers[i]);
+  }
+  free(workers);
+  if (listener >= 0) {
+    close(listener);
+    unlink(config->path);
+  }
+  close(epoll);
+  close(stop);
+  return ok;
+}
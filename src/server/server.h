@@ -0,0 +1,65 @@
+#ifndef BRICK_GAME_SERVER_SERVER_H_
+#define BRICK_GAME_SERVER_SERVER_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../brick_game/tetris/tetris.h"
+
+/**
+ * brickd protocol over a Unix stream socket, one game per connection:
+ *   client -> server  one byte per input, (hold << 3) | UserAction_t
+ *   server -> client  kFrameMessageBytes per frame, little endian:
+ *     version (u64) score (u32) high_score (u32) level (u8) speed (u8)
+ *     flags (u8: pause | running << 1) next (u16, 4 bits per row)
+ *     field (kRowBytes per row, FRAME_ROWS rows)
+ * A slow client gets only the latest frame, older ones are skipped. The
+ * server closes the connection after the frame of a Terminate.
+ */
+typedef enum {
+  kRowBytes = (FRAME_COLS + 7) / 8,
+  kFrameHeaderBytes = 21,
+  kFrameMessageBytes = kFrameHeaderBytes + FRAME_ROWS * kRowBytes,
+  kServerMaxWorkers = 256,
+  kServerReadBytes = 256
+} ServerLimits_t;
+
+typedef struct {
+  const char *path;  // socket file, replaced if it exists
+  int workers;
+  int max_sessions;  // per worker
+} ServerConfig_t;
+
+typedef struct {
+  TetrisInfo_t *game;   // NULL while the slot is free
+  uint32_t generation;  // sessions the slot has held, tags its epoll events
+  int fd;
+  int timer;             // timerfd of the next gravity step
+  bool want_write;       // EPOLLOUT is on, the socket is full
+  bool frame_due;        // the game changed since the last frame
+  int out_length;
+  int out_sent;
+  uint8_t out[kFrameMessageBytes];
+} Session_t;
+
+/** One thread with its own epoll set and its own shard of sessions */
+typedef struct {
+  pthread_t thread;
+  int index;
+  int epoll;
+  int inbox[2];  // pipe, the acceptor writes client fds, -1 stops the worker
+  atomic_int sessions;
+  int max_sessions;
+  Session_t *session;
+  int *free_slot;
+  int free_count;
+  unsigned long served;
+  unsigned long inputs;
+  unsigned long frames;
+} ServerWorker_t;
+
+void encodeFrame(const Frame_t *frame, uint8_t *message);
+void decodeFrame(const uint8_t *message, Frame_t *frame);
+bool runServer(const ServerConfig_t *config);
+
+#endif  // BRICK_GAME_SERVER_SERVER_H_
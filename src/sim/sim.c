@@ -0,0 +1,252 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sim.h"
+
+#include <math.h>
+
+static double clockSec(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Up to two random keys per gravity step, hard drops are rare
+int randomPolicy(TetrisInfo_t *game, const SimConfig_t *config,
+                 SimPolicyState_t *state, UserAction_t *actions) {
+  (void)game;
+  (void)config;
+  static const UserAction_t keys[] = {Left, Right, Action, Left,
+                                      Right, Action, Up, Down};
+  int count = randomBelow(&state->rng, 3);
+  for (int i = 0; i < count; i++) {
+    actions[i] = keys[randomBelow(&state->rng, 8)];
+  }
+  return count;
+}
+
+// One script letter per gravity step, the script starts over at its end
+int scriptedPolicy(TetrisInfo_t *game, const SimConfig_t *config,
+                   SimPolicyState_t *state, UserAction_t *actions) {
+  (void)game;
+  (void)config;
+  int count = 0;
+  if (state->script && state->script[0]) {
+    char key = state->script[state->script_pos++];
+    if (state->script[state->script_pos] == '\0') {
+      state->script_pos = 0;
+    }
+    switch (key) {
+      case 'l':
+        actions[count++] = Left;
+        break;
+      case 'r':
+        actions[count++] = Right;
+        break;
+      case 'a':
+        actions[count++] = Action;
+        break;
+      case 'd':
+        actions[count++] = Down;
+        break;
+      default:
+        break;
+    }
+  }
+  return count;
+}
+
+// Keys of the plan up to its next fall, which the gravity step after this
+// call makes
+static int planInputs(SimPolicyState_t *state, UserAction_t *actions) {
+  int count = 0;
+  bool fall = false;
+  while (!fall && state->plan_pos < state->plan_length) {
+    fall = !moveInput(state->plan[state->plan_pos++], &actions[count]);
+    count += !fall;
+  }
+  return count;
+}
+
+// Once per figure, the plan of the placement the bot module likes best
+int botPolicy(TetrisInfo_t *game, const SimConfig_t *config,
+              SimPolicyState_t *state, UserAction_t *actions) {
+  (void)config;
+  if (state->planned_piece != game->pieces) {
+    state->planned_piece = game->pieces;
+    state->plan_length =
+        botPlan(game, &kBotWeights, state->memory->scratch, state->plan);
+    state->plan_pos = 0;
+  }
+  return planInputs(state, actions);
+}
+
+// Like botPolicy() with the preview, the one-figure bot if no planner
+int beamPolicy(TetrisInfo_t *game, const SimConfig_t *config,
+               SimPolicyState_t *state, UserAction_t *actions) {
+  (void)config;
+  if (state->planned_piece != game->pieces) {
+    state->planned_piece = game->pieces;
+    SimMemory_t *memory = state->memory;
+    state->plan_length =
+        memory->beam
+            ? beamPlan(memory->beam, game, state->plan)
+            : botPlan(game, &kBotWeights, memory->scratch, state->plan);
+    state->plan_pos = 0;
+  }
+  return planInputs(state, actions);
+}
+
+// Only what the policy of the config needs, false when memory is short
+bool createSimMemory(SimMemory_t *memory, const SimConfig_t *config) {
+  memset(memory, 0, sizeof(*memory));
+  bool ok = true;
+  if (config->policy == kPolicyBot || config->policy == kPolicyBeam) {
+    memory->scratch = malloc(sizeof(BotScratch_t));
+    ok = memory->scratch != NULL;
+  }
+  if (ok && config->policy == kPolicyBeam) {
+    memory->beam = createBeam(&config->beam, &kBotWeights);
+  }
+  return ok;
+}
+
+void destroySimMemory(SimMemory_t *memory) {
+  if (memory->beam) {
+    destroyBeam(memory->beam);
+  }
+  free(memory->scratch);
+  memset(memory, 0, sizeof(*memory));
+}
+
+// Plays a moving game on a virtual clock till it ends, every gravity step
+// right after another, the policy seeded by seed
+int playStartedGame(TetrisInfo_t *game, const SimConfig_t *config,
+                    SimMemory_t *memory, uint64_t seed,
+                    unsigned long *pieces) {
+  static const SimPolicy_t policies[] = {randomPolicy, scriptedPolicy,
+                                         botPolicy, beamPolicy};
+  SimPolicyState_t state = {.script = config->script, .memory = memory};
+  seedRng(&state.rng, ~seed);
+  if (memory->beam) {
+    resetBeam(memory->beam);
+  }
+  while (game->state == kMoving && game->pieces <= config->max_pieces) {
+    UserAction_t actions[kSimMaxPlan];
+    int count = policies[config->policy](game, config, &state, actions);
+    for (int i = 0; i < count; i++) {
+      tetrisUserInput(game, actions[i], false);
+    }
+    advanceClock(game, game->update_interval);
+    applyGravity(game);
+  }
+  *pieces = game->pieces;
+  return game->score;
+}
+
+// One game from an empty field
+int playGame(TetrisInfo_t *game, const SimConfig_t *config,
+             SimMemory_t *memory, uint64_t seed, unsigned long *pieces) {
+  initTetrisInfo(game);
+  seedTetrisGame(game, seed);
+  setRandomizer(game, config->randomizer);
+  setVirtualClock(game, 0);
+  tetrisUserInput(game, Start, false);
+  return playStartedGame(game, config, memory, seed, pieces);
+}
+
+static void *simWorker(void *arg) {
+  SimWorker_t *worker = arg;
+  const SimConfig_t *config = worker->config;
+  double cpu_start = clockSec(CLOCK_THREAD_CPUTIME_ID);
+  double wall_start = clockSec(CLOCK_MONOTONIC);
+  // Contiguous block of games, the context lives on this thread's stack
+  // and the bot memory on its heap, both reused by every game
+  int first = (int)((long)config->games * worker->index / config->threads);
+  int last = (int)((long)config->games * (worker->index + 1) / config->threads);
+  TetrisInfo_t game;
+  SimMemory_t memory;
+  bool ok = createSimMemory(&memory, config);
+  for (int i = first; ok && i < last; i++) {
+    unsigned long pieces = 0;
+    worker->scores[i] = playGame(&game, config, &memory,
+                                 config->first_seed + (uint64_t)i, &pieces);
+    worker->pieces += pieces;
+    worker->games++;
+  }
+  destroySimMemory(&memory);
+  worker->busy_sec = clockSec(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+  worker->wall_sec = clockSec(CLOCK_MONOTONIC) - wall_start;
+  return NULL;
+}
+
+bool runSimulation(const SimConfig_t *config, SimReport_t *report) {
+  memset(report, 0, sizeof(*report));
+  report->games = config->games;
+  report->threads = config->threads;
+  report->scores = calloc(config->games > 0 ? config->games : 1, sizeof(int));
+  bool ok = report->scores != NULL && config->threads > 0 &&
+            config->threads <= kSimMaxThreads;
+  double wall_start = clockSec(CLOCK_MONOTONIC);
+  int started = 0;
+  for (int i = 0; ok && i < config->threads; i++) {
+    SimWorker_t *worker = &report->worker[i];
+    worker->index = i;
+    worker->config = config;
+    worker->scores = report->scores;
+    ok = pthread_create(&worker->thread, NULL, simWorker, worker) == 0;
+    started += ok;
+  }
+  int played = 0;
+  for (int i = 0; i < started; i++) {
+    pthread_join(report->worker[i].thread, NULL);
+    report->pieces += report->worker[i].pieces;
+    played += report->worker[i].games;
+  }
+  ok = ok && played == config->games;
+  report->wall_sec = clockSec(CLOCK_MONOTONIC) - wall_start;
+  return ok;
+}
+
+void freeSimReport(SimReport_t *report) {
+  free(report->scores);
+  report->scores = NULL;
+}
+
+static int compareScores(const void *a, const void *b) {
+  int lhs = *(const int *)a;
+  int rhs = *(const int *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+// Sorts report->scores in place
+void printSimReport(SimReport_t *report, FILE *out) {
+  int n = report->games;
+  double wall = report->wall_sec > 0 ? report->wall_sec : 1e-9;
+  fprintf(out, "games      %d in %.3f s, %.1f games/s\n", n, report->wall_sec,
+          n / wall);
+  fprintf(out, "pieces     %lu, %.1f pieces/s\n", report->pieces,
+          report->pieces / wall);
+  if (n > 0) {
+    qsort(report->scores, n, sizeof(int), compareScores);
+    double sum = 0;
+    double square_sum = 0;
+    for (int i = 0; i < n; i++) {
+      sum += report->scores[i];
+      square_sum += (double)report->scores[i] * report->scores[i];
+    }
+    double mean = sum / n;
+    double variance = square_sum / n - mean * mean;
+    fprintf(out,
+            "score      min %d, p50 %d, p90 %d, p99 %d, max %d, "
+            "mean %.1f, stddev %.1f\n",
+            report->scores[0], report->scores[n / 2],
+            report->scores[(int)(n * 0.9)], report->scores[(int)(n * 0.99)],
+            report->scores[n - 1], mean, sqrt(variance > 0 ? variance : 0));
+  }
+  for (int i = 0; i < report->threads; i++) {
+    const SimWorker_t *worker = &report->worker[i];
+    fprintf(out, "thread %-3d %d games, %lu pieces, %.1f%% busy\n", i,
+            worker->games, worker->pieces,
+            100.0 * worker->busy_sec / wall);
+  }
+}
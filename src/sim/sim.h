@@ -0,0 +1,97 @@
+#ifndef BRICK_GAME_SIM_SIM_H_
+#define BRICK_GAME_SIM_SIM_H_
+
+#include <pthread.h>
+
+#include "../brick_game/bot/beam.h"
+#include "../brick_game/bot/bot.h"
+#include "../brick_game/tetris/tetris.h"
+
+typedef enum {
+  kSimMaxThreads = 256,
+  kSimMaxPlan = kBotMaxPlan  // inputs a policy plays before one step
+} SimLimits_t;
+
+/** Who presses the keys in a simulated game */
+typedef enum {
+  kPolicyRandom,
+  kPolicyScripted,
+  kPolicyBot,
+  kPolicyBeam
+} SimPolicyKind_t;
+
+typedef struct {
+  int games;
+  int threads;
+  uint64_t first_seed;  // game i is seeded with first_seed + i
+  SimPolicyKind_t policy;
+  const char *script;  // kPolicyScripted: l r a d per gravity step, . waits
+  unsigned long max_pieces;  // a game stops here even without game over
+  Randomizer_t randomizer;
+  BeamConfig_t beam;  // kPolicyBeam, one planner per worker
+} SimConfig_t;
+
+/** Memory of the bot policies, made once per worker and kept over its
+ * games */
+typedef struct {
+  BotScratch_t *scratch;  // kPolicyBot, kPolicyBeam
+  Beam_t *beam;           // kPolicyBeam, NULL falls back to the bot
+} SimMemory_t;
+
+/** Private state of one policy inside one worker */
+typedef struct {
+  Rng_t rng;
+  const char *script;
+  int script_pos;
+  unsigned long planned_piece;
+  MoveCode_t plan[kBotMaxPlan];  // steps of the bot policies for the figure
+  int plan_length;
+  int plan_pos;  // steps before it were played
+  SimMemory_t *memory;
+} SimPolicyState_t;
+
+/** Fills the inputs played before the next gravity step, returns how many */
+typedef int (*SimPolicy_t)(TetrisInfo_t *game, const SimConfig_t *config,
+                           SimPolicyState_t *state, UserAction_t *actions);
+
+typedef struct {
+  pthread_t thread;
+  int index;
+  const SimConfig_t *config;
+  int *scores;  // shared array, a worker writes only its own games
+  int games;
+  unsigned long pieces;
+  double busy_sec;  // thread CPU time
+  double wall_sec;
+} SimWorker_t;
+
+typedef struct {
+  int *scores;  // one per game
+  int games;
+  unsigned long pieces;
+  double wall_sec;
+  int threads;
+  SimWorker_t worker[kSimMaxThreads];
+} SimReport_t;
+
+int randomPolicy(TetrisInfo_t *game, const SimConfig_t *config,
+                 SimPolicyState_t *state, UserAction_t *actions);
+int scriptedPolicy(TetrisInfo_t *game, const SimConfig_t *config,
+                   SimPolicyState_t *state, UserAction_t *actions);
+int botPolicy(TetrisInfo_t *game, const SimConfig_t *config,
+              SimPolicyState_t *state, UserAction_t *actions);
+int beamPolicy(TetrisInfo_t *game, const SimConfig_t *config,
+               SimPolicyState_t *state, UserAction_t *actions);
+
+bool createSimMemory(SimMemory_t *memory, const SimConfig_t *config);
+void destroySimMemory(SimMemory_t *memory);
+int playStartedGame(TetrisInfo_t *game, const SimConfig_t *config,
+                    SimMemory_t *memory, uint64_t seed,
+                    unsigned long *pieces);
+int playGame(TetrisInfo_t *game, const SimConfig_t *config,
+             SimMemory_t *memory, uint64_t seed, unsigned long *pieces);
+bool runSimulation(const SimConfig_t *config, SimReport_t *report);
+void freeSimReport(SimReport_t *report);
+void printSimReport(SimReport_t *report, FILE *out);
+
+#endif  // BRICK_GAME_SIM_SIM_H_